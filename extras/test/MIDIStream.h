@@ -0,0 +1,105 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+// Split a raw MIDI byte stream, like a recording of a DIN port, into channel
+// messages and System Exclusive messages. Running status is supported; system
+// common and realtime bytes are skipped, an interrupted System Exclusive
+// message is dropped.
+#pragma once
+
+#include <V2MIDI.h>
+#include <stddef.h>
+#include <vector>
+
+// The message is called with 3 bytes, the System Exclusive function with the
+// complete message including the start and end byte.
+template <typename Message, typename SystemExclusive>
+static void parseMIDIStream(const uint8_t *data, size_t len, Message message, SystemExclusive systemExclusive) {
+  uint8_t status = 0;
+  uint8_t bytes[3]{};
+  uint8_t count = 0;
+
+  bool sysex = false;
+  std::vector<uint8_t> buffer;
+
+  for (size_t i = 0; i < len; i++) {
+    const uint8_t b = data[i];
+
+    // Realtime messages can appear anywhere.
+    if (b >= 0xf8)
+      continue;
+
+    if (b == 0xf0) {
+      sysex  = true;
+      status = 0;
+      buffer.assign(1, b);
+      continue;
+    }
+
+    if (b == 0xf7) {
+      if (sysex) {
+        buffer.push_back(b);
+        systemExclusive(buffer.data(), buffer.size());
+      }
+
+      sysex = false;
+      continue;
+    }
+
+    if (b & 0x80) {
+      sysex  = false;
+      status = b < 0xf0 ? b : 0;
+      count  = 0;
+      continue;
+    }
+
+    if (sysex) {
+      buffer.push_back(b);
+      continue;
+    }
+
+    if (status == 0)
+      continue;
+
+    bytes[1 + count++] = b;
+
+    const uint8_t length = ((status & 0xf0) == 0xc0 || (status & 0xf0) == 0xd0) ? 1 : 2;
+    if (count < length)
+      continue;
+
+    bytes[0] = status;
+    if (length == 1)
+      bytes[2] = 0;
+
+    message(bytes);
+    count = 0;
+  }
+}
+
+// Returns NULL for messages V2Mackie does not handle.
+static V2MIDI::Packet *setMIDIPacket(V2MIDI::Packet *packet, const uint8_t message[3]) {
+  const uint8_t channel = message[0] & 0x0f;
+
+  switch (message[0] & 0xf0) {
+    case 0x80:
+      return packet->setNoteOff(channel, message[1], message[2]);
+
+    case 0x90:
+      return packet->setNote(channel, message[1], message[2]);
+
+    case 0xa0:
+      return packet->setAftertouch(channel, message[1], message[2]);
+
+    case 0xb0:
+      return packet->setControlChange(channel, message[1], message[2]);
+
+    case 0xd0:
+      return packet->setAftertouchChannel(channel, message[1]);
+
+    case 0xe0:
+      return packet->setPitchBend(channel, (int16_t)(message[1] | (message[2] << 7)) - 8192);
+
+    default:
+      return NULL;
+  }
+}
@@ -0,0 +1,573 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "Reference.h"
+#include <V2MackieProtocol.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// The typed button handlers; the notes of a group are consecutive.
+static const struct {
+  uint8_t note;
+  uint8_t count;
+  const char *type;
+  const char *names[8];
+} Buttons[]{
+  {Mackie::ChannelStrip::Button::Arm, 8, "strip-button", {"arm"}},
+  {Mackie::ChannelStrip::Button::Solo, 8, "strip-button", {"solo"}},
+  {Mackie::ChannelStrip::Button::Mute, 8, "strip-button", {"mute"}},
+  {Mackie::ChannelStrip::Button::Select, 8, "strip-button", {"select"}},
+  {Mackie::ChannelStrip::VPot::Push, 8, "strip-button", {"vpot"}},
+  {Mackie::ChannelStrip::Fader::Touch, 8, "strip-button", {"touch"}},
+  {Mackie::Main::Touch, 1, "touch", {}},
+  {Mackie::Transport::Rewind, 5, "transport", {"rewind", "forward", "stop", "play", "record"}},
+  {Mackie::Bank::Previous, 6, "bank", {"previous", "next", "previous-channel", "next-channel", "flip", "edit"}},
+  {Mackie::Function::F1, 16, "function", {}},
+  {Mackie::Modifier::Shift, 4, "modifier", {"shift", "option", "control", "alt"}},
+  {Mackie::Automation::On, 2, "automation", {"on", "record"}},
+  {Mackie::Automation::Snapshot, 2, "automation", {"snapshot", "touch"}},
+  {Mackie::Utility::Undo, 1, "utility", {"undo"}},
+  {Mackie::Utility::Redo, 5, "utility", {"redo", "cancel", "enter", "marker", "mixer"}},
+  {Mackie::Marker::PreviousFrame,
+   7,
+   "marker",
+   {"previous-frame", "next-frame", "loop", "point-in", "point-out", "home", "end"}},
+  {Mackie::Navigation::Up, 6, "navigation", {"up", "down", "left", "right", "zoom", "scrub"}},
+  {Mackie::UserSwitch::S1, 2, "user-switch", {}},
+};
+
+void Reference::log(const char *format, ...) {
+  char line[256];
+  va_list ap;
+  va_start(ap, format);
+  vsnprintf(line, sizeof(line), format, ap);
+  va_end(ap);
+  _log->push_back(line);
+}
+
+void Reference::begin(unsigned long now) {
+  reset();
+}
+
+void Reference::reset() {
+  for (uint8_t i = 0; i < 128; i++)
+    leds[i] = LED::Off;
+
+  for (uint8_t i = 0; i < 9; i++)
+    faders[i] = {};
+
+  for (uint8_t i = 0; i < 8; i++) {
+    vpots[i]  = {};
+    meters[i] = {};
+  }
+
+  memset(display, ' ', sizeof(display));
+  memset(cells, 0, sizeof(cells));
+  memset(lengths, 0, sizeof(lengths));
+  pageChanges = 0xffff;
+  memset(digits, 0, sizeof(digits));
+  link.usec     = 0;
+  link.interval = 0;
+  link.jitter   = 0;
+}
+
+void Reference::setMeterProcessing(uint16_t tickMsec, bool decay, uint8_t hold, uint8_t timeout, unsigned long now) {
+  processing.tick    = tickMsec;
+  processing.decay   = decay;
+  processing.hold    = tickMsec == 0 ? 0 : (hold > 15 ? 15 : hold);
+  processing.timeout = timeout > 15 ? 15 : timeout;
+  processing.usec    = now;
+
+  for (uint8_t i = 0; i < 8; i++) {
+    meters[i].level = 0;
+    meters[i].peak  = 0;
+    meters[i].age   = 0;
+    meters[i].held  = 0;
+    setLevel(i, (uint8_t)(meters[i].fraction * 12.f + 0.5f));
+  }
+}
+
+void Reference::dispatch(const uint8_t message[3], unsigned long now) {
+  const uint8_t channel = message[0] & 0x0f;
+
+  switch (message[0] & 0xf0) {
+    case 0x80:
+      note(channel, message[1], 0, now);
+      break;
+
+    case 0x90:
+      note(channel, message[1], message[2], now);
+      break;
+
+    case 0xb0:
+      controlChange(channel, message[1], message[2]);
+      break;
+
+    case 0xd0:
+      meter(channel, message[1], now);
+      break;
+
+    case 0xe0:
+      pitchBend(channel, (int16_t)(message[1] | (message[2] << 7)) - 8192, now);
+      break;
+  }
+}
+
+void Reference::note(uint8_t channel, uint8_t note, uint8_t velocity, unsigned long now) {
+  if (channel == 15) {
+    if (note == Mackie::Protocol::Ping)
+      ping(now);
+
+    return;
+  }
+
+  if (channel != 0)
+    return;
+
+  int8_t fader = -1;
+  if (note >= Mackie::ChannelStrip::Fader::Touch && note < Mackie::ChannelStrip::Fader::Touch + 8)
+    fader = note - Mackie::ChannelStrip::Fader::Touch;
+
+  else if (note == Mackie::Main::Touch)
+    fader = 8;
+
+  // A touch is a state, not a blinking LED.
+  if (velocity == 0)
+    leds[note] = LED::Off;
+
+  else if (velocity == 1 && fader < 0)
+    leds[note] = LED::Blink;
+
+  else
+    leds[note] = LED::On;
+
+  // The position received while touched is delivered after the release.
+  bool resync = false;
+  if (fader >= 0 && !getButton(note)) {
+    resync                = faders[fader].resync;
+    faders[fader].resync = false;
+  }
+
+  if (fader < 0 && ledFrames)
+    return;
+
+  logButton(note, getButton(note));
+
+  if (resync) {
+    if (fader < 8)
+      log("strip-fader %d %.4f", fader, faders[fader].position);
+
+    else
+      log("fader %.4f", faders[fader].position);
+  }
+}
+
+void Reference::logButton(uint8_t note, bool on) {
+  log("button %d %d", note, on);
+
+  for (const auto &group : Buttons) {
+    if (note < group.note || note >= group.note + group.count)
+      continue;
+
+    const uint8_t index = note - group.note;
+    if (strcmp(group.type, "strip-button") == 0)
+      log("strip-button %d %s %d", index, group.names[0], on);
+
+    else if (strcmp(group.type, "touch") == 0)
+      log("touch %d", on);
+
+    else if (!group.names[0])
+      log("%s %d %d", group.type, index, on);
+
+    else
+      log("%s %s %d", group.type, group.names[index], on);
+
+    return;
+  }
+}
+
+void Reference::controlChange(uint8_t channel, uint8_t controller, uint8_t value) {
+  if (channel != 0)
+    return;
+
+  // Digits are sent right to left.
+  if (controller >= Mackie::Display::Time::Digit && controller < Mackie::Display::Time::Digit + 10) {
+    digits[9 - (controller - Mackie::Display::Time::Digit)] = value;
+    log("time 0");
+    return;
+  }
+
+  if (controller >= Mackie::ChannelStrip::VPot::LED && controller < Mackie::ChannelStrip::VPot::LED + 8) {
+    const uint8_t strip    = controller - Mackie::ChannelStrip::VPot::LED;
+    const uint8_t position = value & 0x0f;
+    VPot *vpot             = &vpots[strip];
+    vpot->led              = value;
+    vpot->center           = value & 0x40;
+
+    if (position == 0) {
+      vpot->mode  = 0;
+      vpot->value = 0;
+
+    } else {
+      switch ((value >> 4) & 3) {
+        // Single dot and bar, 11 LEDs.
+        case Mackie::ChannelStrip::VPot::Single:
+        case Mackie::ChannelStrip::VPot::Bar:
+          vpot->mode  = 2;
+          vpot->value = (float)position / 11.f;
+          break;
+
+        // Boost/cut from the center LED 6.
+        case Mackie::ChannelStrip::VPot::Boost:
+          vpot->mode  = 1;
+          vpot->value = (float)((int)position - 6) / 5.f;
+          break;
+
+        // Spread from the center, 6 steps.
+        case Mackie::ChannelStrip::VPot::Spread:
+          vpot->mode  = 2;
+          vpot->value = (float)position / 6.f;
+          break;
+      }
+    }
+
+    log("vpot-led %d %d", strip, vpot->led);
+    log("vpot %d %d %d %.4f", strip, vpot->mode, vpot->center, vpot->value);
+    return;
+  }
+
+  if (controller == 120 || controller == 123)
+    reset();
+}
+
+void Reference::setLevel(uint8_t strip, uint8_t level) {
+  Meter *meter = &meters[strip];
+  meter->level = level;
+
+  // A new peak restarts the hold time.
+  if (level >= meter->peak) {
+    meter->peak = level;
+    meter->held = 0;
+  }
+}
+
+void Reference::meter(uint8_t channel, uint8_t pressure, unsigned long now) {
+  if (channel != 0)
+    return;
+
+  const uint8_t strip = pressure >> 4;
+  const uint8_t value = pressure & 0x0f;
+  Meter *meter        = &meters[strip];
+
+  bool changed = false;
+  if (value <= 12) {
+    meter->fraction = (float)value / 12.f;
+    setLevel(strip, value);
+
+  } else if (value == 13) {
+    // TotalMix: the maximum level.
+    meter->fraction = 1;
+    setLevel(strip, 12);
+
+  } else if (value == 14) {
+    changed         = !meter->overload;
+    meter->overload = true;
+
+  } else {
+    changed         = meter->overload;
+    meter->overload = false;
+  }
+
+  meter->usec = now;
+  meter->age  = 0;
+
+  if (changed)
+    log("meter-overload %d %d", strip, meter->overload);
+
+  log("meter %d %.4f %d", strip, meter->fraction, meter->overload);
+}
+
+void Reference::pitchBend(uint8_t channel, int16_t value, unsigned long now) {
+  if (channel > 8)
+    return;
+
+  if (value > 8176)
+    value = 8176;
+
+  const float fraction = (float)(value + 8192) / 16368.f;
+  const uint8_t touch  = channel < 8 ? Mackie::ChannelStrip::Fader::Touch + channel : Mackie::Main::Touch;
+  Fader *fader         = &faders[channel];
+  fader->position      = fraction;
+
+  // The host echoes a sent position.
+  const bool echo = fader->sent && now - fader->sentUsec < 500 * 1000 && fraction - fader->sentPosition > -0.005f &&
+                    fraction - fader->sentPosition < 0.005f;
+
+  if (getButton(touch)) {
+    fader->resync = !echo;
+    return;
+  }
+
+  if (echo)
+    return;
+
+  if (channel < 8)
+    log("strip-fader %d %.4f", channel, fraction);
+
+  else
+    log("fader %.4f", fraction);
+}
+
+void Reference::sendFader(uint8_t fader, float fraction, unsigned long now) {
+  faders[fader].sent         = true;
+  faders[fader].sentPosition = fraction;
+  faders[fader].sentUsec     = now;
+}
+
+void Reference::sendTouch(uint8_t fader, bool on) {
+  leds[fader < 8 ? Mackie::ChannelStrip::Fader::Touch + fader : Mackie::Main::Touch] = on ? LED::On : LED::Off;
+  if (on || !faders[fader].resync)
+    return;
+
+  faders[fader].resync = false;
+  if (fader < 8)
+    log("strip-fader %d %.4f", fader, faders[fader].position);
+
+  else
+    log("fader %.4f", faders[fader].position);
+}
+
+void Reference::dispatchSystemExclusive(const uint8_t *buffer, uint32_t len, unsigned long now) {
+  // Start, vendor, device, type, offset, end.
+  if (len < 8)
+    return;
+
+  if (buffer[1] != 0x00 || buffer[2] != 0x00 || buffer[3] != 0x66)
+    return;
+
+  if (buffer[4] != Mackie::Message::Device::Control && buffer[4] != Mackie::Message::Device::ControlXT)
+    return;
+
+  if (buffer[5] != Mackie::Message::Type::Display)
+    return;
+
+  const uint8_t offset = buffer[6];
+  const uint32_t count = len - 8;
+  if (offset + count > sizeof(display) || count == 0)
+    return;
+
+  bool global[2];
+  for (uint8_t row = 0; row < 2; row++)
+    global[row] = isGlobal(row);
+
+  memcpy(display + offset, buffer + 7, count);
+
+  // The cells which were written to.
+  uint16_t changed = 0;
+  for (uint8_t cell = offset / 7; cell <= (offset + count - 1) / 7; cell++) {
+    if (memcmp(cells[cell], display + (cell * 7), 7) == 0)
+      continue;
+
+    memcpy(cells[cell], display + (cell * 7), 7);
+    changed |= 1 << cell;
+
+    lengths[cell] = 7;
+    while (lengths[cell] > 0 && cells[cell][lengths[cell] - 1] == ' ')
+      lengths[cell]--;
+  }
+
+  for (uint8_t row = 0; row < 2; row++) {
+    if (isGlobal(row) == global[row])
+      continue;
+
+    global[row] = isGlobal(row);
+    log("display-global %d %d", row, global[row]);
+  }
+
+  if (changed == 0)
+    return;
+
+  pageChanges |= changed;
+
+  for (uint8_t cell = 0; cell < 16; cell++) {
+    if (changed & (1 << cell))
+      log("strip-display %d %d %d '%.7s'", global[cell / 8], cell % 8, cell / 8, cells[cell]);
+  }
+
+  log("display %04x", changed);
+  for (uint8_t row = 0; row < 2; row++) {
+    const uint8_t strips = changed >> (row * 8);
+    if (strips != 0)
+      log("display-row %d %d %02x", global[row], row, strips);
+  }
+}
+
+// A row shows a global message if the space after any of its cells is overwritten.
+bool Reference::isGlobal(uint8_t row) {
+  for (uint8_t strip = 0; strip < 8; strip++) {
+    if (display[(row * 56) + (strip * 7) + 6] != ' ')
+      return true;
+  }
+
+  return false;
+}
+
+float Reference::getPeak(uint8_t strip) {
+  if (processing.hold == 0)
+    return meters[strip].fraction;
+
+  return (float)meters[strip].peak / 12.f;
+}
+
+// The digits are 7-segment characters, the dot is bit 6.
+uint16_t Reference::getTimeNumber(uint8_t first, uint8_t count) {
+  uint16_t number = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    const char c = digits[first + i] & 0x3f;
+    number *= 10;
+    if (c >= '0' && c <= '9')
+      number += c - '0';
+  }
+
+  return number;
+}
+
+void Reference::ping(unsigned long now) {
+  if (link.usec > 0) {
+    const int64_t interval = (int64_t)(now - link.usec);
+
+    if (link.interval == 0) {
+      link.interval = interval;
+
+    } else {
+      const int64_t deviation = interval > link.interval ? interval - link.interval : link.interval - interval;
+
+      // Bucket n: shorter than 2^n milliseconds.
+      uint8_t bucket = 7;
+      for (uint8_t i = 0; i < 7; i++) {
+        if (deviation < (1000LL << i)) {
+          bucket = i;
+          break;
+        }
+      }
+      link.histogram[bucket]++;
+
+      link.interval = (int64_t)link.interval + (interval - (int64_t)link.interval) / 8;
+      link.jitter   = (int64_t)link.jitter + (deviation - (int64_t)link.jitter) / 8;
+    }
+  }
+
+  link.usec = now == 0 ? 1 : now;
+  link.pings++;
+  log("ping");
+}
+
+uint32_t Reference::getLinkTimeout() {
+  if (link.interval == 0)
+    return 5000 * 1000;
+
+  const uint64_t timeout = (uint64_t)link.interval * 3 / 2 + (4 * (uint64_t)link.jitter);
+  if (timeout < 250 * 1000)
+    return 250 * 1000;
+
+  if (timeout > 5000 * 1000)
+    return 5000 * 1000;
+
+  return timeout;
+}
+
+void Reference::loop(unsigned long now) {
+  // The blinking LEDs are off in the first half of the 500 milliseconds period.
+  const bool phase = (now / (250 * 1000)) & 1;
+  uint32_t visible[4]{};
+  for (uint8_t note = 0; note < 128; note++) {
+    if (leds[note] == LED::On || (leds[note] == LED::Blink && phase))
+      visible[note / 32] |= 1UL << (note % 32);
+  }
+
+  if (memcmp(visible, frame, sizeof(frame)) != 0) {
+    memcpy(frame, visible, sizeof(frame));
+    log("leds %08x %08x %08x %08x", frame[0], frame[1], frame[2], frame[3]);
+  }
+
+  if (link.usec > 0 && now - link.usec > getLinkTimeout()) {
+    link.usec     = 0;
+    link.interval = 0;
+    link.jitter   = 0;
+    link.timeouts++;
+    log("timeout");
+  }
+
+  loopMeters(now);
+}
+
+void Reference::loopMeters(unsigned long now) {
+  if (processing.tick == 0) {
+    for (uint8_t i = 0; i < 8; i++) {
+      if (meters[i].fraction <= 0 || now - meters[i].usec < 1000 * 1000)
+        continue;
+
+      meters[i].fraction = 0;
+      meters[i].overload = false;
+      meters[i].usec     = 0;
+      meters[i].level    = 0;
+      meters[i].peak     = 0;
+      log("meter %d %.4f %d", i, 0.f, 0);
+    }
+
+    return;
+  }
+
+  // A single tick per call.
+  if (now - processing.usec < (unsigned long)processing.tick * 1000)
+    return;
+
+  processing.usec += (unsigned long)processing.tick * 1000;
+
+  for (uint8_t i = 0; i < 8; i++) {
+    Meter *meter        = &meters[i];
+    const uint8_t level = meter->level;
+    const uint8_t peak  = meter->peak;
+
+    if (meter->age < 15)
+      meter->age++;
+
+    if (meter->held < 15)
+      meter->held++;
+
+    const bool expired = processing.timeout > 0 && meter->age >= processing.timeout;
+    if (expired)
+      meter->level = 0;
+
+    if (processing.decay && meter->level > 0)
+      meter->level--;
+
+    // A released peak falls by one step, but not below the level.
+    if (expired)
+      meter->peak = 0;
+
+    else if (meter->held >= processing.hold && meter->peak > 0)
+      meter->peak--;
+
+    if (meter->peak < meter->level)
+      meter->peak = meter->level;
+
+    bool changed = meter->level != level || (processing.hold > 0 && meter->peak != peak);
+    bool overload = false;
+    if (expired && meter->overload) {
+      changed         = true;
+      overload        = true;
+      meter->overload = false;
+    }
+
+    if (!changed)
+      continue;
+
+    meter->fraction = (float)meter->level / 12.f;
+    if (overload)
+      log("meter-overload %d %d", i, 0);
+
+    log("meter %d %.4f %d", i, meter->fraction, meter->overload);
+  }
+}
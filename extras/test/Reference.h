@@ -0,0 +1,128 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+// A slow and simple model of the Mackie Control state machine of V2Mackie,
+// written from the protocol description instead of the optimized code: plain
+// arrays, one strip at a time, the display scanned as a whole. It records
+// every handler call as a line of text, the format matches the V2Mackie
+// subclass of the differential tester.
+//
+// Not modeled: the HUI protocol, events, change sets, the output queue.
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Reference {
+public:
+  enum class LED { Off, Blink, On };
+
+  explicit Reference(std::vector<std::string> *log) : _log(log) {}
+
+  void begin(unsigned long now);
+  void setMeterProcessing(uint16_t tickMsec, bool decay, uint8_t hold, uint8_t timeout, unsigned long now);
+  void setLEDFrames(bool on) {
+    ledFrames = on;
+  }
+
+  // A channel message, status and two data bytes.
+  void dispatch(const uint8_t message[3], unsigned long now);
+  void dispatchSystemExclusive(const uint8_t *buffer, uint32_t len, unsigned long now);
+  void loop(unsigned long now);
+
+  // The local fader, 0..7 strips, 8 main.
+  void sendFader(uint8_t fader, float fraction, unsigned long now);
+  void sendTouch(uint8_t fader, bool on);
+
+  // The state, read by the tester.
+  LED leds[128]{};
+
+  // The last delivered LED frame.
+  uint32_t frame[4]{};
+
+  // LED messages are delivered only as frames.
+  bool ledFrames{};
+
+  struct Fader {
+    float position;
+    bool resync;
+    bool sent;
+    float sentPosition;
+    unsigned long sentUsec;
+  } faders[9]{};
+
+  struct VPot {
+    uint8_t mode; // Off, Pan, Bar
+    bool center;
+    float value;
+    uint8_t led;
+  } vpots[8]{};
+
+  struct Meter {
+    float fraction;
+    bool overload;
+    unsigned long usec;
+
+    // 0..12 and the tick counts of the processing.
+    uint8_t level;
+    uint8_t peak;
+    uint8_t age;
+    uint8_t held;
+  } meters[8]{};
+
+  struct {
+    uint16_t tick;
+    bool decay;
+    uint8_t hold;
+    uint8_t timeout;
+    unsigned long usec;
+  } processing{};
+
+  char display[56 * 2]{};
+
+  // The cells as returned by getStripText(), row 0 followed by row 1. Empty
+  // until the first Display message writes them.
+  char cells[16][8]{};
+
+  // The length of the cell without trailing spaces, updated when it changes.
+  uint8_t lengths[16]{};
+
+  // The cells changed since the last read of the display page.
+  uint16_t pageChanges{};
+
+  // The raw time digits, left to right.
+  uint8_t digits[10]{};
+
+  struct {
+    unsigned long usec; // 0 if not active
+    uint32_t interval;
+    uint32_t jitter;
+    uint32_t histogram[8];
+    uint32_t pings;
+    uint32_t timeouts;
+  } link{};
+
+  bool getButton(uint8_t note) {
+    return leds[note] != LED::Off;
+  }
+
+  bool isGlobal(uint8_t row);
+  float getPeak(uint8_t strip);
+  uint16_t getTimeNumber(uint8_t first, uint8_t count);
+  uint32_t getLinkTimeout();
+
+private:
+  std::vector<std::string> *_log;
+
+  void log(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  void reset();
+  void note(uint8_t channel, uint8_t note, uint8_t velocity, unsigned long now);
+  void logButton(uint8_t note, bool on);
+  void controlChange(uint8_t channel, uint8_t controller, uint8_t value);
+  void meter(uint8_t channel, uint8_t pressure, unsigned long now);
+  void setLevel(uint8_t strip, uint8_t level);
+  void pitchBend(uint8_t channel, int16_t value, unsigned long now);
+  void ping(unsigned long now);
+  void loopMeters(unsigned long now);
+};
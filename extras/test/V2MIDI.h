@@ -0,0 +1,116 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+// Host stand-in for the V2MIDI library and the Arduino functions it provides,
+// to build V2Mackie on Linux. Only the parts V2Mackie uses are implemented.
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <string.h>
+
+inline unsigned long micros() {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+namespace V2MIDI {
+namespace CC {
+  enum {
+    AllSoundOff = 120,
+    AllNotesOff = 123,
+  };
+};
+
+// A USB-MIDI event packet: code index, status, two data bytes.
+class Packet {
+public:
+  enum class Status : uint8_t {
+    NoteOff           = 0x80,
+    NoteOn            = 0x90,
+    Aftertouch        = 0xa0,
+    ControlChange     = 0xb0,
+    ProgramChange     = 0xc0,
+    AftertouchChannel = 0xd0,
+    PitchBend         = 0xe0,
+    SystemExclusive   = 0xf0,
+  };
+
+  Status getType() {
+    return (Status)(_data[1] & 0xf0);
+  }
+
+  uint8_t getChannel() {
+    return _data[1] & 0x0f;
+  }
+
+  Packet *setNote(uint8_t channel, uint8_t note, uint8_t velocity) {
+    return set(0x90 | channel, note, velocity);
+  }
+
+  Packet *setNoteOff(uint8_t channel, uint8_t note, uint8_t velocity = 64) {
+    return set(0x80 | channel, note, velocity);
+  }
+
+  uint8_t getNote() {
+    return _data[2];
+  }
+
+  uint8_t getNoteVelocity() {
+    return _data[3];
+  }
+
+  Packet *setAftertouch(uint8_t channel, uint8_t note, uint8_t pressure) {
+    return set(0xa0 | channel, note, pressure);
+  }
+
+  uint8_t getAftertouchNote() {
+    return _data[2];
+  }
+
+  uint8_t getAftertouch() {
+    return _data[3];
+  }
+
+  Packet *setControlChange(uint8_t channel, uint8_t controller, uint8_t value) {
+    return set(0xb0 | channel, controller, value);
+  }
+
+  uint8_t getController() {
+    return _data[2];
+  }
+
+  uint8_t getControllerValue() {
+    return _data[3];
+  }
+
+  Packet *setAftertouchChannel(uint8_t channel, uint8_t pressure) {
+    return set(0xd0 | channel, pressure, 0);
+  }
+
+  uint8_t getAftertouchChannel() {
+    return _data[2];
+  }
+
+  // -8192..8191
+  Packet *setPitchBend(uint8_t channel, int16_t value) {
+    value += 8192;
+    return set(0xe0 | channel, value & 0x7f, (value >> 7) & 0x7f);
+  }
+
+  int16_t getPitchBend() {
+    return (int16_t)(_data[2] | (_data[3] << 7)) - 8192;
+  }
+
+private:
+  uint8_t _data[4]{};
+
+  Packet *set(uint8_t status, uint8_t data1, uint8_t data2) {
+    _data[0] = status >> 4;
+    _data[1] = status;
+    _data[2] = data1;
+    _data[3] = data2;
+    return this;
+  }
+};
+};
@@ -0,0 +1,674 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+// Differential tester: feed the same MIDI stream to V2Mackie and to the
+// reference model, and compare the handler calls and the state after every
+// message. The clock is simulated, the streams are random or recordings of a
+// host in raw MIDI format.
+//
+//   differential [-s seed] [-n streams] [file ...]
+
+#include "MIDIStream.h"
+#include "Reference.h"
+#include <V2Mackie.h>
+#include <V2MackieProtocol.h>
+#include <algorithm>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *StripButtonNames[]{"arm", "mute", "select", "solo", "touch", "vpot"};
+static const char *TransportNames[]{"rewind", "forward", "stop", "play", "record"};
+static const char *BankNames[]{"previous", "next", "previous-channel", "next-channel", "flip", "edit"};
+static const char *ModifierNames[]{"shift", "option", "control", "alt"};
+static const char *NavigationNames[]{"up", "down", "left", "right", "zoom", "scrub"};
+static const char *AutomationNames[]{"on", "record", "snapshot", "touch"};
+static const char *UtilityNames[]{"undo", "redo", "cancel", "enter", "marker", "mixer"};
+static const char *MarkerNames[]{"previous-frame", "next-frame", "loop", "point-in", "point-out", "home", "end"};
+
+class Device : public V2Mackie {
+public:
+  explicit Device(std::vector<std::string> *log) : _log(log) {}
+
+  unsigned long now{};
+
+protected:
+  unsigned long getMicros() override {
+    return now;
+  }
+
+  void handleStripVPotDisplay(uint8_t strip, VPotMode mode, bool center, float fraction) override {
+    log("vpot %d %d %d %.4f", strip, (int)mode, center, fraction);
+  }
+
+  void handleStripVPotDisplay(uint8_t strip, uint8_t value) override {
+    log("vpot-led %d %d", strip, value);
+  }
+
+  void handleStripButton(uint8_t strip, StripButton button, bool on) override {
+    log("strip-button %d %s %d", strip, StripButtonNames[(int)button], on);
+  }
+
+  void handleStripFader(uint8_t strip, float fraction) override {
+    log("strip-fader %d %.4f", strip, fraction);
+  }
+
+  void handleStripMeter(uint8_t strip, float fraction, bool overload) override {
+    log("meter %d %.4f %d", strip, fraction, overload);
+  }
+
+  void handleStripMeterOverload(uint8_t strip, bool overload) override {
+    log("meter-overload %d %d", strip, overload);
+  }
+
+  void handleStripDisplay(bool global, uint8_t strip, uint8_t row) override {
+    log("strip-display %d %d %d '%.7s'", global, strip, row, getStripText(strip, row));
+  }
+
+  void handleDisplayGlobal(uint8_t row, bool global) override {
+    log("display-global %d %d", row, global);
+  }
+
+  void handleDisplay(uint16_t cells) override {
+    log("display %04x", cells);
+  }
+
+  void handleDisplayRow(bool global, uint8_t row, uint8_t strips) override {
+    log("display-row %d %d %02x", global, row, strips);
+  }
+
+  void handleFader(float fraction) override {
+    log("fader %.4f", fraction);
+  }
+
+  void handleTouch(bool on) override {
+    log("touch %d", on);
+  }
+
+  void handleButton(uint8_t note, bool on) override {
+    log("button %d %d", note, on);
+  }
+
+  void handleLEDs(const uint32_t leds[4]) override {
+    log("leds %08x %08x %08x %08x", leds[0], leds[1], leds[2], leds[3]);
+  }
+
+  void handleTransportButton(TransportButton button, bool on) override {
+    log("transport %s %d", TransportNames[(int)button], on);
+  }
+
+  void handleBankButton(BankButton button, bool on) override {
+    log("bank %s %d", BankNames[(int)button], on);
+  }
+
+  void handleModifierButton(ModifierButton button, bool on) override {
+    log("modifier %s %d", ModifierNames[(int)button], on);
+  }
+
+  void handleNavigationButton(NavigationButton button, bool on) override {
+    log("navigation %s %d", NavigationNames[(int)button], on);
+  }
+
+  void handleFunctionButton(uint8_t function, bool on) override {
+    log("function %d %d", function, on);
+  }
+
+  void handleAutomationButton(AutomationButton button, bool on) override {
+    log("automation %s %d", AutomationNames[(int)button], on);
+  }
+
+  void handleUtilityButton(UtilityButton button, bool on) override {
+    log("utility %s %d", UtilityNames[(int)button], on);
+  }
+
+  void handleMarkerButton(MarkerButton button, bool on) override {
+    log("marker %s %d", MarkerNames[(int)button], on);
+  }
+
+  void handleUserSwitch(uint8_t index, bool on) override {
+    log("user-switch %d %d", index, on);
+  }
+
+  void handleTime(Time::Type type) override {
+    log("time %d", (int)type);
+  }
+
+  void handlePing() override {
+    log("ping");
+  }
+
+  void handleTimeout() override {
+    log("timeout");
+  }
+
+private:
+  std::vector<std::string> *_log;
+
+  void log(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    char line[256];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(line, sizeof(line), format, ap);
+    va_end(ap);
+    _log->push_back(line);
+  }
+};
+
+// One test run: the device, the model and the description of the last step.
+class Run {
+public:
+  Run() : _device(&_deviceLog), _reference(&_referenceLog) {}
+
+  void begin(unsigned long now) {
+    _device.now = now;
+    _device.begin();
+    _reference.begin(now);
+    _now = now;
+    compare("begin");
+  }
+
+  void setMeterProcessing(uint16_t tickMsec, bool decay, uint8_t hold, uint8_t timeout) {
+    _device.setMeterProcessing(tickMsec, decay, hold, timeout);
+    _reference.setMeterProcessing(tickMsec, decay, hold, timeout, _now);
+
+    char step[64];
+    snprintf(step, sizeof(step), "meter processing %d %d %d %d", tickMsec, decay, hold, timeout);
+    compare(step);
+  }
+
+  void setLEDFrames(bool on) {
+    _device.setLEDFrames(on);
+    _reference.setLEDFrames(on);
+  }
+
+  void advance(unsigned long usec) {
+    _now += usec;
+    _device.now = _now;
+  }
+
+  void message(const uint8_t message[3]) {
+    V2MIDI::Packet packet;
+    if (!setMIDIPacket(&packet, message))
+      return;
+
+    _device.dispatchPacket(&packet);
+    _reference.dispatch(message, _now);
+
+    char step[64];
+    snprintf(step, sizeof(step), "message %02x %02x %02x", message[0], message[1], message[2]);
+    compare(step);
+  }
+
+  void systemExclusive(const uint8_t *buffer, uint32_t len) {
+    _device.dispatchSystemExclusive(buffer, len);
+    _reference.dispatchSystemExclusive(buffer, len, _now);
+
+    char step[64];
+    snprintf(step, sizeof(step), "system exclusive, %u bytes, offset %d", len, len > 6 ? buffer[6] : -1);
+    compare(step);
+  }
+
+  void loop() {
+    _device.loop();
+    _reference.loop(_now);
+    compare("loop");
+  }
+
+  void sendFader(uint8_t fader, float fraction) {
+    V2MIDI::Packet packet;
+    if (fader < 8)
+      _device.sendStripFader(&packet, fader, fraction);
+
+    else
+      _device.sendFader(&packet, fraction);
+
+    _reference.sendFader(fader, fraction, _now);
+
+    char step[64];
+    snprintf(step, sizeof(step), "send fader %d %.4f", fader, fraction);
+    compare(step);
+  }
+
+  void sendTouch(uint8_t fader, bool on) {
+    V2MIDI::Packet packet;
+    if (fader < 8)
+      _device.sendStripTouch(&packet, fader, on);
+
+    else
+      _device.sendTouch(&packet, on);
+
+    _reference.sendTouch(fader, on);
+
+    char step[64];
+    snprintf(step, sizeof(step), "send touch %d %d", fader, on);
+    compare(step);
+  }
+
+  bool failed() {
+    return _failed;
+  }
+
+private:
+  Device _device;
+  Reference _reference;
+  std::vector<std::string> _deviceLog;
+  std::vector<std::string> _referenceLog;
+  unsigned long _now{};
+  uint32_t _steps{};
+  bool _failed{};
+
+  void fail(const char *step, const char *format, ...) __attribute__((format(printf, 3, 4))) {
+    if (_failed)
+      return;
+
+    _failed = true;
+
+    char text[256];
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(text, sizeof(text), format, ap);
+    va_end(ap);
+    printf("step %u, %s, time %lu: %s\n", _steps, step, _now, text);
+  }
+
+  void compare(const char *step) {
+    _steps++;
+    if (_failed)
+      return;
+
+    compareLog(step);
+    compareState(step);
+    _deviceLog.clear();
+    _referenceLog.clear();
+  }
+
+  void compareLog(const char *step) {
+    if (_deviceLog == _referenceLog)
+      return;
+
+    fail(step, "handler calls differ");
+    const size_t count = std::max(_deviceLog.size(), _referenceLog.size());
+    for (size_t i = 0; i < count; i++) {
+      const char *device    = i < _deviceLog.size() ? _deviceLog[i].c_str() : "";
+      const char *reference = i < _referenceLog.size() ? _referenceLog[i].c_str() : "";
+      printf("  %c %-40s %s\n", strcmp(device, reference) == 0 ? ' ' : '!', device, reference);
+    }
+  }
+
+  static bool isEqual(float a, float b) {
+    return fabsf(a - b) < 0.0001f;
+  }
+
+  void compareState(const char *step) {
+    for (uint8_t note = 0; note < 128; note++) {
+      const V2Mackie::LED led = _device.getLED(note);
+      if ((int)led != (int)_reference.leds[note])
+        fail(step, "LED %d: %d, expected %d", note, (int)led, (int)_reference.leds[note]);
+    }
+
+    const uint32_t *frame = _device.getLEDs();
+    if (memcmp(frame, _reference.frame, sizeof(_reference.frame)) != 0)
+      fail(step, "LED frame differs");
+
+    for (uint8_t fader = 0; fader < 9; fader++) {
+      const float position = fader < 8 ? _device.getStripFader(fader) : _device.getFader();
+      if (!isEqual(position, _reference.faders[fader].position))
+        fail(step, "fader %d: %.4f, expected %.4f", fader, position, _reference.faders[fader].position);
+    }
+
+    for (uint8_t strip = 0; strip < 8; strip++) {
+      bool center;
+      float fraction;
+      const V2Mackie::VPotMode mode = _device.getStripVPot(strip, center, fraction);
+      const Reference::VPot *vpot   = &_reference.vpots[strip];
+      if ((int)mode != vpot->mode || center != vpot->center || !isEqual(fraction, vpot->value))
+        fail(step, "vpot %d: %d %d %.4f, expected %d %d %.4f", strip, (int)mode, center, fraction, vpot->mode,
+             vpot->center, vpot->value);
+
+      bool overload;
+      const float meter            = _device.getStripMeter(strip, overload);
+      const Reference::Meter *ref = &_reference.meters[strip];
+      if (!isEqual(meter, ref->fraction) || overload != ref->overload)
+        fail(step, "meter %d: %.4f %d, expected %.4f %d", strip, meter, overload, ref->fraction, ref->overload);
+
+      const float peak = _device.getStripMeterPeak(strip);
+      if (!isEqual(peak, _reference.getPeak(strip)))
+        fail(step, "meter peak %d: %.4f, expected %.4f", strip, peak, _reference.getPeak(strip));
+
+      for (uint8_t row = 0; row < 2; row++) {
+        const uint8_t cell = (row * 8) + strip;
+        uint8_t len;
+        const char *text = _device.getStripText(strip, row, len);
+        if (memcmp(text, _reference.cells[cell], 8) != 0 || len != _reference.lengths[cell])
+          fail(step, "cell %d %d: '%.7s' %d, expected '%.7s' %d", strip, row, text, len, _reference.cells[cell],
+               _reference.lengths[cell]);
+      }
+    }
+
+    for (uint8_t row = 0; row < 2; row++) {
+      if (_device.isDisplayGlobal(row) != _reference.isGlobal(row))
+        fail(step, "display row %d global: %d", row, _device.isDisplayGlobal(row));
+    }
+
+    uint16_t cells;
+    const V2Mackie::Cell *page = _device.getDisplayPage(cells);
+    if (cells != _reference.pageChanges)
+      fail(step, "display page changes %04x, expected %04x", cells, _reference.pageChanges);
+
+    _reference.pageChanges = 0;
+    for (uint8_t cell = 0; cell < 16; cell++) {
+      if (memcmp(page[cell].text, _reference.cells[cell], 8) != 0)
+        fail(step, "display page cell %d: '%.7s', expected '%.7s'", cell, page[cell].text, _reference.cells[cell]);
+    }
+
+    V2Mackie::LinkStatistics link;
+    _device.getLinkStatistics(link);
+    if (link.active != (_reference.link.usec > 0) || link.interval != _reference.link.interval ||
+        link.jitter != _reference.link.jitter || link.timeout != _reference.getLinkTimeout() ||
+        link.pings != _reference.link.pings || link.timeouts != _reference.link.timeouts ||
+        memcmp(link.histogram, _reference.link.histogram, sizeof(link.histogram)) != 0)
+      fail(step,
+           "link: %d %u %u %u %u %u, expected %d %u %u %u %u %u",
+           link.active,
+           link.interval,
+           link.jitter,
+           link.timeout,
+           link.pings,
+           link.timeouts,
+           _reference.link.usec > 0,
+           _reference.link.interval,
+           _reference.link.jitter,
+           _reference.getLinkTimeout(),
+           _reference.link.pings,
+           _reference.link.timeouts);
+
+    // The copy for a different core matches the direct getters.
+    V2Mackie::Snapshot snapshot;
+    if (!_device.getSnapshot(snapshot)) {
+      fail(step, "snapshot failed");
+      return;
+    }
+
+    if (memcmp(snapshot.buttons, _device.getButtons(), sizeof(snapshot.buttons)) != 0 ||
+        snapshot.fader != _device.getFader())
+      fail(step, "snapshot differs");
+
+    for (uint8_t strip = 0; strip < 8; strip++) {
+      bool overload;
+      if (snapshot.strips[strip].fader != _device.getStripFader(strip) ||
+          snapshot.strips[strip].meter != _device.getStripMeter(strip, overload) ||
+          snapshot.strips[strip].overload != overload ||
+          strcmp(snapshot.strips[strip].display[0], _device.getStripText(strip, 0)) != 0 ||
+          strcmp(snapshot.strips[strip].display[1], _device.getStripText(strip, 1)) != 0)
+        fail(step, "snapshot strip %d differs", strip);
+    }
+  }
+};
+
+// A small xorshift generator; the streams are reproducible from the seed.
+class Random {
+public:
+  explicit Random(uint64_t seed) : _state(seed * 0x9e3779b97f4a7c15ULL + 1) {}
+
+  uint32_t next() {
+    _state ^= _state << 13;
+    _state ^= _state >> 7;
+    _state ^= _state << 17;
+    return _state >> 32;
+  }
+
+  uint32_t below(uint32_t n) {
+    return next() % n;
+  }
+
+  bool chance(uint32_t percent) {
+    return below(100) < percent;
+  }
+
+private:
+  uint64_t _state;
+};
+
+// A note biased towards the notes with special handling.
+static uint8_t getNote(Random &random) {
+  switch (random.below(4)) {
+    case 0:
+      return Mackie::ChannelStrip::Fader::Touch + random.below(8);
+
+    case 1:
+      return Mackie::Main::Touch;
+
+    default:
+      return random.below(128);
+  }
+}
+
+static uint8_t getVelocity(Random &random) {
+  static const uint8_t velocities[]{0, 1, 127, 64};
+  return velocities[random.below(4)];
+}
+
+static void runRandom(Run &run, Random &random, uint32_t steps) {
+  run.begin(1 + random.below(1000 * 1000));
+
+  auto setMeterProcessing = [&]() {
+    run.setMeterProcessing(random.chance(25) ? 0 : 10 + random.below(200),
+                           random.chance(50),
+                           random.below(17),
+                           random.below(17));
+  };
+
+  if (random.chance(50))
+    setMeterProcessing();
+
+  run.setLEDFrames(random.chance(25));
+
+  // The last positions of the host, to create echoes of local fader moves.
+  float sent[9]{};
+
+  for (uint32_t i = 0; i < steps && !run.failed(); i++) {
+    if (random.chance(30)) {
+      // Mostly short steps, sometimes long enough to expire a timeout.
+      const uint32_t usec = random.chance(95) ? random.below(50 * 1000) : random.below(8000 * 1000);
+      run.advance(usec);
+    }
+
+    uint8_t message[3]{};
+    switch (random.below(20)) {
+      case 0 ... 4:
+        message[0] = random.chance(80) ? 0x90 : 0x80;
+        message[1] = getNote(random);
+        message[2] = getVelocity(random);
+        run.message(message);
+        break;
+
+      case 5:
+        // Host ping.
+        message[0] = 0x9f;
+        message[1] = Mackie::Protocol::Ping;
+        message[2] = 127;
+        run.message(message);
+        break;
+
+      case 6 ... 8: {
+        const uint8_t channel = random.below(10);
+        int16_t value         = (int16_t)random.below(16384) - 8192;
+
+        // The echo of a local move.
+        if (channel < 9 && random.chance(30))
+          value = (int16_t)(sent[channel] * 16368.f) - 8192 + (int16_t)random.below(40) - 20;
+
+        value += 8192;
+        if (value < 0)
+          value = 0;
+
+        if (value > 16383)
+          value = 16383;
+
+        message[0] = 0xe0 | channel;
+        message[1] = value & 0x7f;
+        message[2] = value >> 7;
+        run.message(message);
+      } break;
+
+      case 9:
+        message[0] = 0xb0;
+        message[1] = Mackie::ChannelStrip::VPot::LED + random.below(8);
+        message[2] = random.below(128);
+        run.message(message);
+        break;
+
+      case 10:
+        message[0] = 0xb0;
+        message[1] = Mackie::Display::Time::Digit + random.below(10);
+        message[2] = random.below(128);
+        run.message(message);
+        break;
+
+      case 11:
+        message[0] = 0xb0;
+        message[1] = random.chance(90) ? random.below(128) : 123;
+        message[2] = random.below(128);
+        if (message[1] == 120 || message[1] == 123) {
+          if (!random.chance(5))
+            break;
+
+          message[2] = 0;
+        }
+        run.message(message);
+        break;
+
+      case 12 ... 13:
+        message[0] = random.chance(95) ? 0xd0 : 0xd0 | random.below(16);
+        message[1] = random.below(128);
+        run.message(message);
+        break;
+
+      case 14 ... 15: {
+        uint8_t buffer[128];
+        const uint8_t offset = random.chance(90) ? random.below(112) : random.below(128);
+        uint8_t len          = random.below(40);
+        if (random.chance(20))
+          len = 7;
+
+        buffer[0] = 0xf0;
+        buffer[1] = 0x00;
+        buffer[2] = 0x00;
+        buffer[3] = 0x66;
+        buffer[4] = random.chance(90) ? 0x14 : random.below(128);
+        buffer[5] = random.chance(95) ? 0x12 : random.below(128);
+        buffer[6] = offset;
+        for (uint8_t c = 0; c < len; c++) {
+          static const char characters[]{' ', ' ', ' ', 'A', 'b', '1', '-', '.', '\0'};
+          buffer[7 + c] = characters[random.below(sizeof(characters))];
+        }
+
+        buffer[7 + len] = 0xf7;
+        uint32_t size   = 8 + len;
+        if (random.chance(3))
+          size = random.below(size);
+
+        run.systemExclusive(buffer, size);
+      } break;
+
+      case 16: {
+        const uint8_t fader  = random.below(9);
+        const float fraction = (float)random.below(1001) / 1000.f;
+        sent[fader]          = fraction;
+        run.sendFader(fader, fraction);
+      } break;
+
+      case 17:
+        run.sendTouch(random.below(9), random.chance(50));
+        break;
+
+      case 18:
+        if (random.chance(2))
+          setMeterProcessing();
+
+        else
+          run.loop();
+        break;
+
+      default:
+        run.loop();
+        break;
+    }
+  }
+}
+
+static bool runFile(const char *name) {
+  FILE *file = fopen(name, "rb");
+  if (!file) {
+    printf("%s: cannot open\n", name);
+    return false;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+    data.insert(data.end(), buffer, buffer + n);
+
+  fclose(file);
+
+  // One millisecond per message, like a busy host.
+  Run run;
+  run.begin(1);
+  parseMIDIStream(
+    data.data(),
+    data.size(),
+    [&](const uint8_t message[3]) {
+      run.advance(1000);
+      run.message(message);
+      run.loop();
+    },
+    [&](const uint8_t *sysex, size_t len) {
+      run.advance(1000);
+      run.systemExclusive(sysex, len);
+      run.loop();
+    });
+
+  printf("%s: %s\n", name, run.failed() ? "FAILED" : "ok");
+  return !run.failed();
+}
+
+int main(int argc, char **argv) {
+  uint64_t seed    = 1;
+  uint32_t streams = 1000;
+  bool ok          = true;
+  bool files       = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 0);
+      continue;
+    }
+
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      streams = strtoul(argv[++i], NULL, 0);
+      continue;
+    }
+
+    files = true;
+    if (!runFile(argv[i]))
+      ok = false;
+  }
+
+  if (files)
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  for (uint32_t i = 0; i < streams; i++) {
+    Random random(seed + i);
+    Run run;
+    runRandom(run, random, 2000);
+    if (run.failed()) {
+      printf("stream %u failed, seed %llu\n", i, (unsigned long long)(seed + i));
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("%u streams ok\n", streams);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+// Fuzz target for the packet and System Exclusive entry points. The first
+// byte of the input selects the configuration, the rest is a raw MIDI stream.
+// Every message advances the simulated clock by one millisecond and is
+// followed by loop().
+//
+// Built with libFuzzer (clang, 'make fuzz'):
+//   ./fuzz corpus
+//   ./fuzz -merge=1 corpus.new corpus    minimize the corpus
+//
+// Built without libFuzzer ('make benchmark'), the corpus files are replayed
+// as a throughput benchmark, one line per file; a slow file is a performance
+// cliff:
+//   ./benchmark corpus/*
+
+#include "MIDIStream.h"
+#include <V2Mackie.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+class Device : public V2Mackie {
+public:
+  unsigned long now{};
+
+  // Bit 0: HUI, 1: events, 2: change sets, 3: meter processing, 4: output bandwidth.
+  void configure(uint8_t config) {
+    now = 1;
+    setProtocol((config & 1) ? Protocol::HUI : Protocol::Mackie);
+    setEvents(config & 2);
+    setFrameRate((config & 4) ? 30 : 0);
+    setMeterProcessing((config & 8) ? 50 : 0, true, 4, 10);
+    setOutputBandwidth((config & 16) ? 3125 : 0);
+  }
+
+  void run(const uint8_t *data, size_t size) {
+    parseMIDIStream(
+      data,
+      size,
+      [&](const uint8_t message[3]) {
+        V2MIDI::Packet packet;
+        if (!setMIDIPacket(&packet, message))
+          return;
+
+        now += 1000;
+        dispatchPacket(&packet);
+        step();
+      },
+      [&](const uint8_t *buffer, size_t len) {
+        now += 1000;
+        dispatchSystemExclusive(buffer, len);
+        step();
+      });
+  }
+
+protected:
+  unsigned long getMicros() override {
+    return now;
+  }
+
+private:
+  void step() {
+    loop();
+
+    Event event;
+    while (getEvent(event))
+      ;
+
+    uint16_t cells;
+    getDisplayPage(cells);
+  }
+};
+
+// Every input starts with a new device, a crash must not depend on the
+// inputs which ran before.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 1)
+    return 0;
+
+  Device device;
+  device.configure(data[0]);
+  device.run(data + 1, size - 1);
+  return 0;
+}
+
+#ifndef FUZZER
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s FILE...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for (int i = 1; i < argc; i++) {
+    FILE *file = fopen(argv[i], "rb");
+    if (!file) {
+      fprintf(stderr, "%s: cannot open\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+      data.insert(data.end(), buffer, buffer + n);
+
+    fclose(file);
+
+    // Repeat the file for at least 100 milliseconds.
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t runs    = 0;
+    double seconds   = 0;
+    do {
+      for (uint16_t n = 0; n < 100; n++)
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+
+      runs += 100;
+      seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < 0.1);
+
+    printf("%-40s %6zu bytes %10.0f runs/s %8.2f MB/s\n",
+           argv[i],
+           data.size(),
+           (double)runs / seconds,
+           (double)runs * data.size() / seconds / (1000 * 1000));
+  }
+
+  return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,85 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+// Stress test of the display page exchange, a writer and a reader thread.
+// The writer dispatches Display messages of single cells, the reader takes
+// the pages and checks that a page does not change while it is held, and
+// that every cell which differs from the previous page is reported.
+//
+//   ./pages [MESSAGES]
+
+#include <V2Mackie.h>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+class Device : public V2Mackie {};
+
+int main(int argc, char **argv) {
+  const uint32_t messages = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000 * 1000;
+
+  Device device;
+  device.begin();
+
+  std::atomic<bool> done{};
+  uint32_t pages  = 0;
+  uint32_t errors = 0;
+
+  std::thread reader([&]() {
+    uint16_t cells;
+    char last[16][8];
+    memcpy(last, device.getDisplayPage(cells), sizeof(last));
+
+    while (!done.load(std::memory_order_relaxed)) {
+      const V2Mackie::Cell *page = device.getDisplayPage(cells);
+
+      char first[16][8];
+      memcpy(first, page, sizeof(first));
+
+      // Give the writer time to overwrite the page.
+      for (volatile uint8_t i = 0; i < 50; i++)
+        ;
+
+      char again[16][8];
+      memcpy(again, page, sizeof(again));
+      if (memcmp(first, again, sizeof(first)) != 0) {
+        fprintf(stderr, "page changed while it was held\n");
+        errors++;
+      }
+
+      for (uint8_t i = 0; i < 16; i++) {
+        if (memcmp(first[i], last[i], 8) != 0 && !(cells & (1 << i))) {
+          fprintf(stderr, "cell %d changed, not reported\n", i);
+          errors++;
+        }
+      }
+
+      if (cells != 0)
+        pages++;
+
+      memcpy(last, first, sizeof(last));
+    }
+  });
+
+  uint32_t random = 1;
+  for (uint32_t n = 0; n < messages; n++) {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+
+    char text[8];
+    snprintf(text, sizeof(text), "%07u", n % (10 * 1000 * 1000));
+
+    uint8_t buffer[64];
+    const uint8_t len = V2Mackie::setDisplay(buffer, (random % 16) * 7, text, 7);
+    device.dispatchSystemExclusive(buffer, len);
+  }
+
+  done = true;
+  reader.join();
+
+  printf("%u messages, %u pages, %u errors\n", messages, pages, errors);
+  return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
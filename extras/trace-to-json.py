@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# © Kay Sievers <kay@versioduo.com>, 2020-2022
+# SPDX-License-Identifier: Apache-2.0
+
+# Convert the records of V2Mackie::readTrace() to the Chrome trace format,
+# which can be loaded into chrome://tracing or ui.perfetto.dev.
+#
+# The input is the raw memory of the records, 8 bytes each, little-endian:
+#   uint32_t usec, uint8_t type, uint8_t index, uint16_t value
+
+import json
+import struct
+import sys
+
+types = [
+    'PacketBegin',
+    'PacketEnd',
+    'SystemExclusiveBegin',
+    'SystemExclusiveEnd',
+    'HandlerBegin',
+    'HandlerEnd',
+    'LoopBegin',
+    'LoopEnd',
+    'MeterTimeout',
+    'Timeout',
+]
+
+handlers = [
+    'Button',
+    'StripFader',
+    'Fader',
+    'StripVPot',
+    'StripMeter',
+    'StripDisplay',
+    'DisplayGlobal',
+    'Display',
+    'StripChanges',
+    'Time',
+    'LEDs',
+    'Ping',
+    'Timeout',
+    'Send',
+]
+
+
+def convert(data):
+    events = []
+    offset = 0
+    last = None
+
+    for usec, type, index, value in struct.iter_unpack('<IBBH', data):
+        # The clock wraps around after 71 minutes.
+        if last is not None and usec < last:
+            offset += 1 << 32
+        last = usec
+
+        event = {'ts': offset + usec, 'pid': 0, 'tid': 0}
+        name = types[type] if type < len(types) else 'Unknown'
+
+        if name.startswith('Packet'):
+            event['name'] = 'Packet'
+        elif name.startswith('SystemExclusive'):
+            event['name'] = 'SystemExclusive'
+        elif name.startswith('Handler'):
+            event['name'] = handlers[index] if index < len(handlers) else 'Handler'
+        elif name.startswith('Loop'):
+            event['name'] = 'Loop'
+        else:
+            event['name'] = name
+
+        if name.endswith('Begin'):
+            event['ph'] = 'B'
+        elif name.endswith('End'):
+            event['ph'] = 'E'
+        else:
+            event['ph'] = 'i'
+            event['s'] = 't'
+
+        if name == 'PacketBegin':
+            event['args'] = {'status': '0x%02x' % index}
+        elif name == 'SystemExclusiveBegin':
+            event['args'] = {'length': value}
+        elif name == 'MeterTimeout':
+            event['args'] = {'strip': index}
+
+        events.append(event)
+
+    return {'traceEvents': events, 'displayTimeUnit': 'ns'}
+
+
+def main():
+    if len(sys.argv) != 3:
+        print('Usage: %s <trace.bin> <trace.json>' % sys.argv[0], file=sys.stderr)
+        sys.exit(1)
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    data = data[:len(data) - (len(data) % 8)]
+    with open(sys.argv[2], 'w') as f:
+        json.dump(convert(data), f, indent=1)
+
+
+if __name__ == '__main__':
+    main()
@@ -2,280 +2,10 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "V2Mackie.h"
+#include "V2MackieProtocol.h"
 
-namespace Mackie {
-// System Exclusive Messages.
-namespace Message {
-  // Header:  vendor prefix, device type, message type.
-  namespace Header {
-    enum {
-      Vendor,
-      Device = 3,
-      Type,
-      Message,
-    };
-  };
-
-  // 3 bytes MIDI vendor ID.
-  static constexpr uint8_t Vendor[3]{0x00, 0x00, 0x66};
-
-  namespace Device {
-    enum {
-      Control   = 20,
-      ControlXT = 21,
-    };
-  };
-
-  namespace Type {
-    enum {
-      TranportButtonClick = 10,
-
-      // 0..127 minutes
-      BacklightTimout = 11,
-
-      TouchlessFader = 12,
-
-      // strip, 0..5
-      TouchSensitivity = 14,
-
-      TimeDisplay = 16,
-
-      ModeDisplay = 17,
-
-      // offset, characters
-      Display = 18,
-
-      Version      = 19,
-      VersionReply = 20,
-
-      // strip, mode
-      MeterMode = 32,
-
-      // 0 = horizontal / 1 = vertical
-      MeterOrientation = 33,
-
-      FaderHome = 97,
-      LEDsOff   = 98,
-      Reset     = 99
-    };
-  };
-
-  // 1 byte index, up to 56 * 2 bytes text.
-  namespace Display::Header {
-    enum {
-      Index,
-      Text,
-    };
-  };
-};
-
-namespace Display {
-  // 56 character, 2 row LCD display.
-  // 8 channel strips * 7 characters == 56.
-  namespace Strip {
-    enum Note { NameValue = 52 };
-  };
-
-  // 10 digits, 3-2-2-3 grouping.
-  namespace Time {
-    enum CC {
-      // 64-73, reverse order/right to left.
-      Digit = 64
-    };
-
-    // Switch between Hours-Minutes-Seconds-Frames and Bars-Beats-SubDivision-Ticks mode.
-    enum Note { SMPTEBeats = 53 };
-  };
-
-  // 2 digits.
-  namespace Mode {
-    enum CC {
-      // 74-57, reverse order/right to left.
-      Digit = 74
-    };
-  };
-};
-
-namespace ChannelStrip {
-  // Push and rotary control.
-  namespace VPot {
-    enum Mode {
-      Single,
-      Boost,
-      Bar,
-      Spread,
-    };
-
-    enum CC {
-      // Bit 0..5: steps
-      // Bit 6:    0 == clockwise, 1 == counter clockwise
-      Encoder = 16,
-
-      // Bit 0..3: value
-      // Bit 4..5: mode
-      // Bit 6:    center dot
-      LED = 48,
-    };
-
-    enum Note {
-      Push       = 32,
-      Track      = 40,
-      Send       = 41,
-      Pan        = 42,
-      PlugIn     = 43,
-      Equalizer  = 44,
-      Instrument = 45,
-    };
-  };
-
-  // Buttons and fader touch.
-  namespace Button {
-    enum Note {
-      Arm    = 0,
-      Solo   = 8,
-      Mute   = 16,
-      Select = 24,
-    };
-  };
-
-  // The fader controls pitch bend channel 1-8.
-  namespace Fader {
-    enum Note {
-      Touch = 104,
-    };
-  };
-
-  // The meter is Channel Aftertouch 4 bit index + value 0..12 + overload flag.
-};
-
-// The main fader.
-namespace Main {
-  enum Note {
-    // Value 0/127.
-    Touch = 112
-  };
-
-  // The main fader controls pitch bend channel 9
-};
-
-namespace Bank {
-  enum Note {
-    // Move 8/16/32 channel strips. Up to three extension units, each adds 8
-    // channel strips to a bank.
-    Previous = 46,
-    Next     = 47,
-
-    // Move a single channel.
-    PreviousChannel = 48,
-    NextChannel     = 49,
-
-    Flip = 50,
-    Edit = 51,
-  };
-};
-
-namespace Function {
-  enum Note {
-    F1  = 54,
-    F2  = 55,
-    F3  = 56,
-    F4  = 57,
-    F5  = 58,
-    F6  = 59,
-    F7  = 60,
-    F8  = 61,
-    F9  = 62,
-    F10 = 63,
-    F11 = 64,
-    F12 = 65,
-    F13 = 66,
-    F14 = 67,
-    F15 = 68,
-    F16 = 69,
-  };
-};
-
-namespace Modifier {
-  enum Note {
-    Shift   = 70,
-    Option  = 71,
-    Control = 72,
-    Alt     = 73,
-  };
-};
-
-namespace Automation {
-  enum Note {
-    On       = 74,
-    Record   = 75,
-    Snapshot = 77,
-    Touch    = 78,
-  };
-};
-
-namespace Utility {
-  enum Note {
-    Undo   = 76,
-    Cancel = 80,
-    Enter  = 81,
-    Redo   = 79,
-    Marker = 82,
-    Mixer  = 83,
-  };
-};
-
-namespace Marker {
-  enum Note {
-    PreviousFrame = 84,
-    NextFrame     = 85,
-    Loop          = 86,
-    PointIn       = 87,
-    PointOut      = 88,
-    Home          = 89,
-    End           = 90,
-  };
-};
-
-namespace Transport {
-  enum Note {
-    Rewind  = 91,
-    Forward = 92,
-    Stop    = 93,
-    Play    = 94,
-    Record  = 95,
-  };
-};
-
-namespace Navigation {
-  enum CC {
-    // Value CW=1/CCW=65.
-    Jog = 60
-  };
-
-  enum Note {
-    Up    = 96,
-    Down  = 97,
-    Left  = 98,
-    Right = 99,
-    Zoom  = 100,
-    Scrub = 101,
-  };
-};
-
-namespace UserSwitch {
-  enum Note {
-    S1 = 102,
-    S2 = 103,
-  };
-};
-
-namespace Protocol {
-  enum Note {
-    // TotalMix: Channel == 16, Velocity == 90, sent every ~800ms.
-    Ping = 127
-  };
-};
-};
+// The configuration the library is built with, see V2Mackie.h.
+void V2Mackie::V2MACKIE_CONFIG() {}
 
 V2MIDI::Packet *V2Mackie::setStripMeter(V2MIDI::Packet *packet, uint8_t strip, float fraction) {
   const uint8_t value = fraction * 12.f;
@@ -292,23 +22,89 @@ V2MIDI::Packet *V2Mackie::setStripFader(V2MIDI::Packet *packet, uint8_t strip, f
   return packet->setPitchBend(strip, value);
 }
 
+uint8_t V2Mackie::setDisplay(uint8_t *buffer, uint8_t offset, const char *text, uint8_t len) {
+  uint8_t n   = 0;
+  buffer[n++] = 0xf0;
+  memcpy(buffer + n, Mackie::Message::Vendor, sizeof(Mackie::Message::Vendor));
+  n += sizeof(Mackie::Message::Vendor);
+
+  buffer[n++] = Mackie::Message::Device::Control;
+  buffer[n++] = Mackie::Message::Type::Display;
+  buffer[n++] = offset;
+
+  memcpy(buffer + n, text, len);
+  n += len;
+  buffer[n++] = 0xf7;
+  return n;
+}
+
+// The text of a strip cell, truncated or padded with spaces to 7 characters.
+void V2Mackie::setCell(char cell[7], const char *text) {
+  uint8_t len = strlen(text);
+  if (len > 7)
+    len = 7;
+
+  memcpy(cell, text, len);
+  memset(cell + len, ' ', 7 - len);
+}
+
 uint8_t V2Mackie::setStripText(uint8_t *buffer, uint8_t strip, uint8_t row, const char *text) {
-  uint8_t len   = 0;
-  buffer[len++] = 0xf0;
-  memcpy(buffer + len, Mackie::Message::Vendor, sizeof(Mackie::Message::Vendor));
-  len += sizeof(Mackie::Message::Vendor);
+  char cell[7];
+  setCell(cell, text);
+  return setDisplay(buffer, (56 * row) + (7 * strip), cell, 7);
+}
+
+static uint8_t getRotationValue(int8_t steps) {
+  // Bit 0..5: steps, Bit 6: counter clockwise.
+  if (steps < 0)
+    return 0x40 | (-steps & 0x3f);
+
+  return steps & 0x3f;
+}
+
+V2MIDI::Packet *V2Mackie::setStripVPot(V2MIDI::Packet *packet, uint8_t strip, int8_t steps) {
+  return packet->setControlChange(0, Mackie::ChannelStrip::VPot::Encoder + strip, getRotationValue(steps));
+}
+
+uint8_t V2Mackie::getMessage(V2MIDI::Packet *packet, uint8_t message[3]) {
+  const uint8_t status = (uint8_t)packet->getType() | packet->getChannel();
 
-  buffer[len++] = Mackie::Message::Device::Control;
-  buffer[len++] = Mackie::Message::Type::Display;
-  buffer[len++] = (56 * row) + (7 * strip);
+  switch (packet->getType()) {
+    case V2MIDI::Packet::Status::NoteOn:
+    case V2MIDI::Packet::Status::NoteOff:
+      message[0] = status;
+      message[1] = packet->getNote();
+      message[2] = packet->getNoteVelocity();
+      return 3;
+
+    case V2MIDI::Packet::Status::Aftertouch:
+      message[0] = status;
+      message[1] = packet->getAftertouchNote();
+      message[2] = packet->getAftertouch();
+      return 3;
+
+    case V2MIDI::Packet::Status::ControlChange:
+      message[0] = status;
+      message[1] = packet->getController();
+      message[2] = packet->getControllerValue();
+      return 3;
+
+    case V2MIDI::Packet::Status::AftertouchChannel:
+      message[0] = status;
+      message[1] = packet->getAftertouchChannel();
+      return 2;
+
+    case V2MIDI::Packet::Status::PitchBend: {
+      const uint16_t value = packet->getPitchBend() + 8192;
+      message[0]           = status;
+      message[1]           = value & 0x7f;
+      message[2]           = value >> 7;
+      return 3;
+    }
 
-  uint8_t textlen = strlen(text);
-  memcpy(buffer + len, text, textlen);
-  len += textlen;
-  memset(buffer + len, ' ', 7 - textlen);
-  len += 7 - textlen;
-  buffer[len++] = 0xf7;
-  return len;
+    default:
+      return 0;
+  }
 }
 
 V2MIDI::Packet *V2Mackie::setStripIndex(V2MIDI::Packet *packet, uint8_t strip) {
@@ -406,35 +202,71 @@ V2MIDI::Packet *V2Mackie::setTouch(V2MIDI::Packet *packet, bool on) {
   return packet->setNote(0, Mackie::Main::Touch, on ? 127 : 0);
 }
 
+V2MIDI::Packet *V2Mackie::sendStripFader(V2MIDI::Packet *packet, uint8_t strip, float fraction) {
+  beginUpdate();
+  _strips[strip].fader.sent = fraction;
+  _strips[strip].fader.usec = getMicros();
+  endUpdate();
+  return setStripFader(packet, strip, fraction);
+}
+
+V2MIDI::Packet *V2Mackie::sendStripTouch(V2MIDI::Packet *packet, uint8_t strip, bool on) {
+  beginUpdate();
+  if (touchFader(&_strips[strip].fader, Mackie::ChannelStrip::Fader::Touch + strip, on))
+    notifyStripFader(strip);
+
+  endUpdate();
+  return setStripButton(packet, strip, StripButton::Touch, on);
+}
+
+V2MIDI::Packet *V2Mackie::sendFader(V2MIDI::Packet *packet, float fraction) {
+  beginUpdate();
+  _main.fader.sent = fraction;
+  _main.fader.usec = getMicros();
+  endUpdate();
+  return setFader(packet, fraction);
+}
+
+V2MIDI::Packet *V2Mackie::sendTouch(V2MIDI::Packet *packet, bool on) {
+  beginUpdate();
+  if (touchFader(&_main.fader, Mackie::Main::Touch, on))
+    notifyFader();
+
+  endUpdate();
+  return setTouch(packet, on);
+}
+
 V2MIDI::Packet *V2Mackie::setStripVPotDisplay(V2MIDI::Packet *packet, uint8_t strip, uint8_t value) {
   return packet->setControlChange(0, Mackie::ChannelStrip::VPot::LED + strip, value);
 }
 
-V2MIDI::Packet *V2Mackie::setStripButton(V2MIDI::Packet *packet, uint8_t strip, StripButton button, bool on) {
+uint8_t V2Mackie::getStripButtonNote(StripButton button) {
   switch (button) {
-    case StripButton::VPot:
-      return packet->setNote(0, Mackie::ChannelStrip::VPot::Push + strip, on ? 127 : 0);
-
     case StripButton::Arm:
-      return packet->setNote(0, Mackie::ChannelStrip::Button::Arm + strip, on ? 127 : 0);
+      return Mackie::ChannelStrip::Button::Arm;
 
     case StripButton::Mute:
-      return packet->setNote(0, Mackie::ChannelStrip::Button::Mute + strip, on ? 127 : 0);
+      return Mackie::ChannelStrip::Button::Mute;
 
     case StripButton::Select:
-      return packet->setNote(0, Mackie::ChannelStrip::Button::Select + strip, on ? 127 : 0);
+      return Mackie::ChannelStrip::Button::Select;
 
     case StripButton::Solo:
-      return packet->setNote(0, Mackie::ChannelStrip::Button::Solo + strip, on ? 127 : 0);
+      return Mackie::ChannelStrip::Button::Solo;
 
     case StripButton::Touch:
-      return packet->setNote(0, Mackie::ChannelStrip::Fader::Touch + strip, on ? 127 : 0);
+      return Mackie::ChannelStrip::Fader::Touch;
 
+    case StripButton::VPot:
     default:
-      return NULL;
+      return Mackie::ChannelStrip::VPot::Push;
   }
 }
 
+V2MIDI::Packet *V2Mackie::setStripButton(V2MIDI::Packet *packet, uint8_t strip, StripButton button, bool on) {
+  return packet->setNote(0, getStripButtonNote(button) + strip, on ? 127 : 0);
+}
+
 V2MIDI::Packet *V2Mackie::setTransportButton(V2MIDI::Packet *packet, TransportButton button, bool on) {
   switch (button) {
     case TransportButton::Rewind:
@@ -530,44 +362,217 @@ V2MIDI::Packet *V2Mackie::setFunctionButton(V2MIDI::Packet *packet, uint8_t func
   return packet->setNote(0, Mackie::Function::F1 + function, on ? 127 : 0);
 }
 
-void V2Mackie::reset() {
-  _active_usec = 0;
-  _display     = {};
-  memset(_display.strip, ' ', sizeof(_display.strip));
-  memset(_strips, 0, sizeof(_strips));
-  _main       = {};
-  _bank       = {};
-  _transport  = {};
-  _navigation = {};
+V2MIDI::Packet *V2Mackie::setAutomationButton(V2MIDI::Packet *packet, AutomationButton button, bool on) {
+  switch (button) {
+    case AutomationButton::On:
+      return packet->setNote(0, Mackie::Automation::On, on ? 127 : 0);
+
+    case AutomationButton::Record:
+      return packet->setNote(0, Mackie::Automation::Record, on ? 127 : 0);
+
+    case AutomationButton::Snapshot:
+      return packet->setNote(0, Mackie::Automation::Snapshot, on ? 127 : 0);
+
+    case AutomationButton::Touch:
+      return packet->setNote(0, Mackie::Automation::Touch, on ? 127 : 0);
+
+    default:
+      return NULL;
+  }
 }
 
-void V2Mackie::loop() {
-  if (_active_usec > 0 && (unsigned long)(micros() - _active_usec) > 5000 * 1000) {
-    _active_usec = 0;
-    handleTimeout();
+V2MIDI::Packet *V2Mackie::setUtilityButton(V2MIDI::Packet *packet, UtilityButton button, bool on) {
+  switch (button) {
+    case UtilityButton::Undo:
+      return packet->setNote(0, Mackie::Utility::Undo, on ? 127 : 0);
+
+    case UtilityButton::Redo:
+      return packet->setNote(0, Mackie::Utility::Redo, on ? 127 : 0);
+
+    case UtilityButton::Cancel:
+      return packet->setNote(0, Mackie::Utility::Cancel, on ? 127 : 0);
+
+    case UtilityButton::Enter:
+      return packet->setNote(0, Mackie::Utility::Enter, on ? 127 : 0);
+
+    case UtilityButton::Marker:
+      return packet->setNote(0, Mackie::Utility::Marker, on ? 127 : 0);
+
+    case UtilityButton::Mixer:
+      return packet->setNote(0, Mackie::Utility::Mixer, on ? 127 : 0);
+
+    default:
+      return NULL;
   }
+}
 
-  for (uint8_t i = 0; i < 8; i++) {
-    if (_strips[i].meter.fraction <= 0.f)
-      continue;
+V2MIDI::Packet *V2Mackie::setMarkerButton(V2MIDI::Packet *packet, MarkerButton button, bool on) {
+  switch (button) {
+    case MarkerButton::PreviousFrame:
+      return packet->setNote(0, Mackie::Marker::PreviousFrame, on ? 127 : 0);
+
+    case MarkerButton::NextFrame:
+      return packet->setNote(0, Mackie::Marker::NextFrame, on ? 127 : 0);
+
+    case MarkerButton::Loop:
+      return packet->setNote(0, Mackie::Marker::Loop, on ? 127 : 0);
 
-    if ((unsigned long)(micros() - _strips[i].meter.usec) < 1000 * 1000)
+    case MarkerButton::PointIn:
+      return packet->setNote(0, Mackie::Marker::PointIn, on ? 127 : 0);
+
+    case MarkerButton::PointOut:
+      return packet->setNote(0, Mackie::Marker::PointOut, on ? 127 : 0);
+
+    case MarkerButton::Home:
+      return packet->setNote(0, Mackie::Marker::Home, on ? 127 : 0);
+
+    case MarkerButton::End:
+      return packet->setNote(0, Mackie::Marker::End, on ? 127 : 0);
+
+    default:
+      return NULL;
+  }
+}
+
+V2MIDI::Packet *V2Mackie::setUserSwitch(V2MIDI::Packet *packet, uint8_t index, bool on) {
+  return packet->setNote(0, Mackie::UserSwitch::S1 + index, on ? 127 : 0);
+}
+
+V2MIDI::Packet *V2Mackie::setButton(V2MIDI::Packet *packet, uint8_t note, bool on) {
+  return packet->setNote(0, note, on ? 127 : 0);
+}
+
+V2MIDI::Packet *V2Mackie::setJog(V2MIDI::Packet *packet, int8_t steps) {
+  return packet->setControlChange(0, Mackie::Navigation::Jog, getRotationValue(steps));
+}
+
+#if V2MACKIE_VPOT
+void V2Mackie::rotate(uint8_t index, int8_t steps) {
+  auto *encoder = &_rotation.encoders[index];
+  int16_t delta = steps;
+
+  if (_rotation.acceleration) {
+    // The time between two detents.
+    const unsigned long usec = getMicros() - encoder->usec;
+    if (usec < 10 * 1000)
+      delta *= 4;
+
+    else if (usec < 30 * 1000)
+      delta *= 2;
+  }
+
+  encoder->usec = getMicros();
+  encoder->steps += delta;
+
+  // Limit the backlog to a few messages.
+  if (encoder->steps > 4 * 63)
+    encoder->steps = 4 * 63;
+
+  else if (encoder->steps < -4 * 63)
+    encoder->steps = -4 * 63;
+}
+
+V2MIDI::Packet *V2Mackie::getRotation(V2MIDI::Packet *packet) {
+  // Round-robin, a continuously rotating encoder does not block the others.
+  for (uint8_t i = 0; i < 9; i++) {
+    const uint8_t index = (_rotation.next + i) % 9;
+    auto *encoder       = &_rotation.encoders[index];
+    if (encoder->steps == 0)
       continue;
 
-    _strips[i].meter = {};
-    handleStripMeter(i, 0, 0);
+    int8_t steps;
+    if (encoder->steps > 63)
+      steps = 63;
+
+    else if (encoder->steps < -63)
+      steps = -63;
+
+    else
+      steps = encoder->steps;
+
+    encoder->steps -= steps;
+    _rotation.next = (index + 1) % 9;
+
+    if (index == 8)
+      return setJog(packet, steps);
+
+    return setStripVPot(packet, index, steps);
   }
+
+  return NULL;
 }
+#endif
 
-void V2Mackie::getStripDisplay(uint8_t strip, uint8_t row, char text[8]) {
-  memcpy(text, _display.strip + (56 * row) + (7 * strip), 7);
-  text[7] = '\0';
+void V2Mackie::reset() {
+  beginUpdate();
+
+  // The next ping starts a new measurement; the counters and the histogram
+  // cover the whole session.
+  _link.usec     = 0;
+  _link.interval = 0;
+  _link.jitter   = 0;
+
+#if V2MACKIE_DISPLAY
+  _display = {};
+  memset(_display.strip, ' ', sizeof(_display.strip));
+#endif
+
+#if V2MACKIE_TIME
+  _time = {};
+#endif
+
+  memset(_strips, 0, sizeof(_strips));
+  memset(_buttons, 0, sizeof(_buttons));
+
+  // Keep the last delivered frame, the next loop() reports the change.
+  memset(_leds.blink, 0, sizeof(_leds.blink));
+  _leds.update = true;
+
+  _main = {};
+  _hui  = {};
+
+#if V2MACKIE_METER
+  _meters.levels = 0;
+  _meters.peaks  = 0;
+  _meters.ages   = 0;
+  _meters.holds  = 0;
+#endif
+
+#if V2MACKIE_DISPLAY
+  flipDisplay(0xffff);
+#endif
+  endUpdate();
+}
+
+void V2Mackie::loop() {
+  V2MACKIE_TRACE_EVENT(LoopBegin, 0, 0);
+  beginUpdate();
+  updateLEDs();
+#if V2MACKIE_OUTPUT
+  loopOutput();
+#endif
+#if V2MACKIE_FRAMES
+  loopFrame();
+#endif
+
+  loopLink();
+#if V2MACKIE_METER
+  loopMeters();
+#endif
+  endUpdate();
+  V2MACKIE_TRACE_EVENT(LoopEnd, 0, 0);
+}
 
-  // Trim trailing spaces.
-  for (uint8_t e = 7; e > 0 && text[e - 1] == ' '; e--)
-    text[e - 1] = '\0';
+#if V2MACKIE_DISPLAY
+void V2Mackie::getStripDisplay(uint8_t strip, uint8_t row, char text[8]) {
+  uint8_t len;
+  const char *cell = getStripText(strip, row, len);
+  memcpy(text, cell, len);
+  text[len] = '\0';
 }
+#endif
 
+#if V2MACKIE_TIME
 static char get7Segment(uint8_t b) {
   // Remove dot.
   b &= 63;
@@ -594,181 +599,725 @@ static uint16_t getNumber(uint8_t *digits, uint8_t length) {
 }
 
 void V2Mackie::getTime(Time &time) {
-  switch (_display.time.type) {
+  switch (_time.type) {
     case Time::Type::SMPTE:
       time.type          = Time::Type::SMPTE;
-      time.smpte.hours   = getNumber(_display.time.digits, 3);
-      time.smpte.minutes = getNumber(_display.time.digits + 3, 2);
-      time.smpte.seconds = getNumber(_display.time.digits + 5, 2);
-      time.smpte.frames  = getNumber(_display.time.digits + 7, 3);
+      time.smpte.hours   = getNumber(_time.digits, 3);
+      time.smpte.minutes = getNumber(_time.digits + 3, 2);
+      time.smpte.seconds = getNumber(_time.digits + 5, 2);
+      time.smpte.frames  = getNumber(_time.digits + 7, 3);
       break;
 
     case Time::Type::Beats:
       time.type              = Time::Type::Beats;
-      time.beats.bars        = getNumber(_display.time.digits, 3);
-      time.beats.beats       = getNumber(_display.time.digits + 3, 2);
-      time.beats.subdivision = getNumber(_display.time.digits + 5, 2);
-      time.beats.ticks       = getNumber(_display.time.digits + 7, 3);
+      time.beats.bars        = getNumber(_time.digits, 3);
+      time.beats.beats       = getNumber(_time.digits + 3, 2);
+      time.beats.subdivision = getNumber(_time.digits + 5, 2);
+      time.beats.ticks       = getNumber(_time.digits + 7, 3);
       break;
   }
 }
+#endif
+
+#if V2MACKIE_DISPLAY
+// The cell words hold the first character in the lowest byte; the space mask,
+// the separator test and the trimmed length depend on that byte order.
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The display cells need a little-endian target");
+
+// The 7 characters of a cell, the 8th byte is zero.
+static uint64_t loadCell(const uint8_t *text) {
+  uint64_t word = 0;
+  memcpy(&word, text, 7);
+  return word;
+}
 
-void V2Mackie::dispatchNote(uint8_t channel, uint8_t note, uint8_t velocity) {
-  switch (channel) {
-    case 0: {
-      switch (note) {
-        case Mackie::ChannelStrip::VPot::Push... Mackie::ChannelStrip::VPot::Push + 7: {
-          const uint8_t strip       = note - Mackie::ChannelStrip::VPot::Push;
-          const bool on             = velocity == 127;
-          _strips[strip].vpot.click = on;
-          handleStripButton(strip, StripButton::VPot, on);
-        } break;
+// The bytes which are not a space are non-zero.
+static uint64_t getCellCharacters(uint64_t word) {
+  return word ^ 0x20202020202020ULL;
+}
 
-        case Mackie::ChannelStrip::Button::Arm... Mackie::ChannelStrip::Button::Arm + 7: {
-          const uint8_t strip       = note - Mackie::ChannelStrip::Button::Arm;
-          const bool on             = velocity == 127;
-          _strips[strip].button.arm = on;
-          handleStripButton(strip, StripButton::Arm, on);
-        } break;
+// The length without trailing spaces.
+static uint8_t getCellLength(uint64_t word) {
+  const uint64_t characters = getCellCharacters(word);
+  if (characters == 0)
+    return 0;
 
-        case Mackie::ChannelStrip::Button::Solo... Mackie::ChannelStrip::Button::Solo + 7: {
-          const uint8_t strip        = note - Mackie::ChannelStrip::Button::Solo;
-          const bool on              = velocity == 127;
-          _strips[strip].button.solo = on;
-          handleStripButton(strip, StripButton::Solo, on);
-        } break;
+  return 8 - (__builtin_clzll(characters) / 8);
+}
 
-        case Mackie::ChannelStrip::Button::Mute... Mackie::ChannelStrip::Button::Mute + 7: {
-          const uint8_t strip        = note - Mackie::ChannelStrip::Button::Mute;
-          const bool on              = velocity == 127;
-          _strips[strip].button.mute = on;
-          handleStripButton(strip, StripButton::Mute, on);
-        } break;
+void V2Mackie::updateDisplay(uint8_t start, uint8_t len) {
+  if (len == 0)
+    return;
 
-        case Mackie::ChannelStrip::Button::Select... Mackie::ChannelStrip::Button::Select + 7: {
-          const uint8_t strip          = note - Mackie::ChannelStrip::Button::Select;
-          const bool on                = velocity == 127;
-          _strips[strip].button.select = on;
-          handleStripButton(strip, StripButton::Select, on);
-        } break;
+  const uint8_t first = start / 7;             // First of the 16 7-character ranges.
+  const uint8_t last  = (start + len - 1) / 7; // Last of the 16 7-character ranges.
+  const uint8_t count = 1 + (last - first);    // Number of 7-character ranges.
 
-        case Mackie::ChannelStrip::Fader::Touch... Mackie::ChannelStrip::Fader::Touch + 7: {
-          const uint8_t strip        = note - Mackie::ChannelStrip::Fader::Touch;
-          const bool on              = velocity == 127;
-          _strips[strip].fader.touch = on;
-          handleStripButton(strip, StripButton::Touch, on);
-        } break;
+  // Try to guess if the display rows are used to show a global message which
+  // is not related to the associated channel strips; check if any of the separating
+  // spaces are overwritten. Only the separators of the written cells are updated.
+  bool global[2];
+  for (uint8_t row = 0; row < 2; row++)
+    global[row] = isDisplayGlobal(row);
 
-        case Mackie::Transport::Rewind: {
-          const bool on     = velocity == 127;
-          _transport.rewind = on;
-          handleTransportButton(TransportButton::Rewind, on);
-        } break;
+  uint16_t cells = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t strip = (first + i) % 8;
+    const uint8_t row   = (first + i) / 8;
+    const uint64_t word = loadCell(_display.strip + (56 * row) + (7 * strip));
 
-        case Mackie::Transport::Forward: {
-          const bool on      = velocity == 127;
-          _transport.forward = on;
-          handleTransportButton(TransportButton::Forward, on);
-        } break;
+    if (getCellCharacters(word) >> 48)
+      _display.separators[row] |= 1 << strip;
 
-        case Mackie::Transport::Stop: {
-          const bool on   = velocity == 127;
-          _transport.stop = on;
-          handleTransportButton(TransportButton::Stop, on);
-        } break;
+    else
+      _display.separators[row] &= ~(1 << strip);
 
-        case Mackie::Transport::Play: {
-          const bool on   = velocity == 127;
-          _transport.play = on;
-          handleTransportButton(TransportButton::Play, on);
-        } break;
+    // Has the content changed?
+    Cell *cell = &_strips[strip].display[row];
+    if (cell->word == word)
+      continue;
 
-        case Mackie::Transport::Record: {
-          const bool on     = velocity == 127;
-          _transport.record = on;
-          handleTransportButton(TransportButton::Record, on);
-        } break;
+    cell->word                 = word;
+    _strips[strip].length[row] = getCellLength(word);
+    cells |= 1 << (first + i);
+  }
 
-        case Mackie::Bank::Previous:
-          handleBankButton(BankButton::Previous, velocity == 127);
-          break;
+  for (uint8_t row = 0; row < 2; row++) {
+    if (global[row] == isDisplayGlobal(row))
+      continue;
 
-        case Mackie::Bank::Next:
-          handleBankButton(BankButton::Next, velocity == 127);
-          break;
+    global[row] = isDisplayGlobal(row);
+    notifyDisplayGlobal(row);
+  }
 
-        case Mackie::Bank::PreviousChannel:
-          handleBankButton(BankButton::PreviousChannel, velocity == 127);
-          break;
+  if (cells == 0)
+    return;
 
-        case Mackie::Bank::Flip: {
-          const bool on = velocity == 127;
-          _bank.flip    = on;
-          handleBankButton(BankButton::Flip, on);
-        } break;
+  flipDisplay(cells);
 
-        case Mackie::Bank::Edit: {
-          const bool on = velocity == 127;
-          _bank.edit    = on;
-          handleBankButton(BankButton::Edit, on);
-        } break;
+  // Generate per-strip/row events.
+  for (uint8_t i = 0; i < 16; i++) {
+    if (cells & (1 << i))
+      notifyStripDisplay(global[i / 8], i % 8, i / 8);
+  }
 
-        case Mackie::Modifier::Shift: {
-          const bool on = velocity == 127;
-          handleModifierButton(ModifierButton::Shift, on);
-        } break;
+  notifyDisplay(global, cells);
+}
 
-        case Mackie::Modifier::Option: {
-          const bool on = velocity == 127;
-          handleModifierButton(ModifierButton::Option, on);
-        } break;
+#if V2MACKIE_SNAPSHOT
+void V2Mackie::flipDisplay(uint16_t cells) {
+  Cell *page = _pages.cells[_pages.back];
+  for (uint8_t i = 0; i < 16; i++)
+    page[i] = _strips[i % 8].display[i / 8];
 
-        case Mackie::Modifier::Control: {
-          const bool on = velocity == 127;
-          handleModifierButton(ModifierButton::Control, on);
-        } break;
+  // Add the changes of the previous page if the reader did not take it.
+  const uint32_t latest = _pages.latest;
+  if (__atomic_load_n(&_pages.front, __ATOMIC_RELAXED) >> 2 == latest >> 2)
+    _pages.pending = cells;
 
-        case Mackie::Modifier::Alt: {
-          const bool on = velocity == 127;
-          handleModifierButton(ModifierButton::Alt, on);
-        } break;
+  else
+    _pages.pending |= cells;
 
-        case Mackie::Navigation::Up: {
-          const bool on = velocity == 127;
-          handleNavigationButton(NavigationButton::Up, on);
-        } break;
+  _pages.changed[_pages.back] = _pages.pending;
+  __atomic_store_n(&_pages.latest, ((latest >> 2) + 1) << 2 | _pages.back, __ATOMIC_RELEASE);
 
-        case Mackie::Navigation::Down: {
-          const bool on = velocity == 127;
-          handleNavigationButton(NavigationButton::Down, on);
-        } break;
+  // Continue with the page which is neither published nor read. The reader
+  // announces its page before it checks that it is still the latest one.
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  const uint8_t front = __atomic_load_n(&_pages.front, __ATOMIC_RELAXED) & 3;
+  if (front == _pages.back)
+    _pages.back = (_pages.back + 1) % 3;
 
-        case Mackie::Navigation::Left: {
-          const bool on = velocity == 127;
-          handleNavigationButton(NavigationButton::Left, on);
-        } break;
+  else
+    _pages.back = 3 - _pages.back - front;
+}
 
-        case Mackie::Navigation::Right: {
-          const bool on = velocity == 127;
-          handleNavigationButton(NavigationButton::Right, on);
-        } break;
+const V2Mackie::Cell *V2Mackie::getDisplayPage(uint16_t &cells) {
+  cells = 0;
+
+  for (;;) {
+    const uint32_t front  = _pages.front;
+    const uint32_t latest = __atomic_load_n(&_pages.latest, __ATOMIC_ACQUIRE);
+    if (latest >> 2 == front >> 2)
+      return _pages.cells[front & 3];
+
+    // Announce the page, but keep the serial of the current one until the
+    // page is taken; the writer then adds the changes to the next page.
+    __atomic_store_n(&_pages.front, (front & ~3u) | (latest & 3), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&_pages.latest, __ATOMIC_RELAXED) != latest)
+      continue;
+
+    __atomic_store_n(&_pages.front, latest, __ATOMIC_RELAXED);
+    cells = _pages.changed[latest & 3];
+    return _pages.cells[latest & 3];
+  }
+}
+#endif
+#endif
+
+void V2Mackie::setButtonState(uint8_t note, LED led) {
+  const uint32_t bit = 1UL << (note % 32);
+
+  if (led == LED::Off)
+    _buttons[note / 32] &= ~bit;
+
+  else
+    _buttons[note / 32] |= bit;
+
+  if (led == LED::Blink)
+    _leds.blink[note / 32] |= bit;
+
+  else
+    _leds.blink[note / 32] &= ~bit;
+
+  _leds.update = true;
+}
+
+void V2Mackie::updateLEDs() {
+  // All blinking LEDs share the same 2 Hz phase.
+  const bool phase = (getMicros() / (250 * 1000)) & 1;
+  if (phase == _leds.phase && !_leds.update)
+    return;
+
+  _leds.phase  = phase;
+  _leds.update = false;
+
+  bool changed = false;
+  for (uint8_t i = 0; i < 4; i++) {
+    const uint32_t frame = _buttons[i] & ~(phase ? 0 : _leds.blink[i]);
+    if (frame == _leds.frame[i])
+      continue;
+
+    _leds.frame[i] = frame;
+    changed        = true;
+  }
+
+  if (changed)
+    notifyLEDs();
+}
+
+#if V2MACKIE_EVENTS
+// Returns true if the change is delivered as an event.
+bool V2Mackie::pushEvent(Event::Type type, uint8_t index, uint16_t value) {
+  if (!_events.enabled)
+    return false;
+
+  const uint8_t size = sizeof(_events.queue) / sizeof(_events.queue[0]);
+
+  for (uint8_t i = 0; i < _events.count; i++) {
+    Event *event = &_events.queue[(_events.head + i) % size];
+    if (event->type != type || event->index != index)
+      continue;
+
+    event->value = value;
+    return true;
+  }
+
+  if (_events.count == size) {
+    _events.lost++;
+    return true;
+  }
+
+  _events.queue[(_events.head + _events.count) % size] = {.type = type, .index = index, .value = value};
+  _events.count++;
+  return true;
+}
+
+bool V2Mackie::getEvent(Event &event) {
+  if (_events.count == 0)
+    return false;
+
+  event        = _events.queue[_events.head];
+  _events.head = (_events.head + 1) % (sizeof(_events.queue) / sizeof(_events.queue[0]));
+  _events.count--;
+  return true;
+}
+#endif
+
+#if V2MACKIE_SNAPSHOT
+// The sequence is odd while the state is updated.
+void V2Mackie::beginUpdate() {
+  if (_snapshot.depth++ > 0)
+    return;
+
+  __atomic_store_n(&_snapshot.sequence, _snapshot.sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void V2Mackie::endUpdate() {
+  if (--_snapshot.depth > 0)
+    return;
+
+  __atomic_store_n(&_snapshot.sequence, _snapshot.sequence + 1, __ATOMIC_RELEASE);
+}
+
+bool V2Mackie::getSnapshot(Snapshot &snapshot, uint8_t tries) {
+  for (uint8_t i = 0; i < tries; i++) {
+    const uint32_t sequence = __atomic_load_n(&_snapshot.sequence, __ATOMIC_ACQUIRE);
+    if ((sequence & 1) == 0) {
+      for (uint8_t s = 0; s < 8; s++) {
+        auto *strip  = &snapshot.strips[s];
+        strip->fader = _strips[s].fader.position;
+#if V2MACKIE_DISPLAY
+        memcpy(strip->display, _strips[s].display, sizeof(strip->display));
+#endif
+#if V2MACKIE_VPOT
+        strip->vpot.mode     = _strips[s].vpot.mode;
+        strip->vpot.center   = _strips[s].vpot.center;
+        strip->vpot.fraction = _strips[s].vpot.value;
+#endif
+#if V2MACKIE_METER
+        strip->meter    = _strips[s].meter.fraction;
+        strip->overload = _strips[s].meter.overload;
+#endif
+      }
+
+#if V2MACKIE_DISPLAY
+      for (uint8_t row = 0; row < 2; row++)
+        snapshot.global[row] = isDisplayGlobal(row);
+#endif
+
+      snapshot.fader = _main.fader.position;
+      memcpy(snapshot.buttons, _buttons, sizeof(snapshot.buttons));
+#if V2MACKIE_TIME
+      getTime(snapshot.time);
+#endif
+
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&_snapshot.sequence, __ATOMIC_RELAXED) == sequence)
+        return true;
+    }
+
+    // Only the reader writes the counter.
+    __atomic_store_n(&_snapshot.retries, _snapshot.retries + 1, __ATOMIC_RELAXED);
+  }
+
+  return false;
+}
+#endif
+
+#if V2MACKIE_FRAMES
+// Returns true if the change is collected for the next frame.
+bool V2Mackie::addStripChange(uint8_t strip, uint8_t change) {
+  if (_frame.fps == 0)
+    return false;
+
+  _frame.changes[strip] |= change;
+  return true;
+}
+
+void V2Mackie::loopFrame() {
+  if (_frame.fps == 0)
+    return;
+
+  if ((unsigned long)(getMicros() - _frame.usec) < 1000UL * 1000 / _frame.fps)
+    return;
+
+  _frame.usec = getMicros();
+
+  bool changed = false;
+  for (uint8_t i = 0; i < 8; i++) {
+    if (_frame.changes[i] != 0) {
+      changed = true;
+      break;
+    }
+  }
+
+  if (!changed)
+    return;
 
-        case Mackie::Navigation::Zoom: {
-          const bool on = velocity == 127;
-          handleNavigationButton(NavigationButton::Zoom, on);
+  uint8_t changes[8];
+  memcpy(changes, _frame.changes, sizeof(changes));
+  memset(_frame.changes, 0, sizeof(_frame.changes));
+
+  V2MACKIE_HANDLER(StripChanges);
+  handleStripChanges(changes);
+}
+#endif
+
+void V2Mackie::notifyButton(uint8_t note, LED led) {
+  if (pushEvent(Event::Type::Button, note, (uint16_t)led))
+    return;
+
+  // The strip button LEDs: arm, solo, mute, select.
+  if (note < Mackie::ChannelStrip::VPot::Push && addStripChange(note % 8, StripChange::Buttons))
+    return;
+
+  V2MACKIE_HANDLER(Button);
+  const bool on = led != LED::Off;
+  handleButton(note, on);
+
+  switch (note) {
+    case Mackie::ChannelStrip::VPot::Push... Mackie::ChannelStrip::VPot::Push + 7:
+      handleStripButton(note - Mackie::ChannelStrip::VPot::Push, StripButton::VPot, on);
+      break;
+
+    case Mackie::ChannelStrip::Button::Arm... Mackie::ChannelStrip::Button::Arm + 7:
+      handleStripButton(note - Mackie::ChannelStrip::Button::Arm, StripButton::Arm, on);
+      break;
+
+    case Mackie::ChannelStrip::Button::Solo... Mackie::ChannelStrip::Button::Solo + 7:
+      handleStripButton(note - Mackie::ChannelStrip::Button::Solo, StripButton::Solo, on);
+      break;
+
+    case Mackie::ChannelStrip::Button::Mute... Mackie::ChannelStrip::Button::Mute + 7:
+      handleStripButton(note - Mackie::ChannelStrip::Button::Mute, StripButton::Mute, on);
+      break;
+
+    case Mackie::ChannelStrip::Button::Select... Mackie::ChannelStrip::Button::Select + 7:
+      handleStripButton(note - Mackie::ChannelStrip::Button::Select, StripButton::Select, on);
+      break;
+
+    case Mackie::ChannelStrip::Fader::Touch... Mackie::ChannelStrip::Fader::Touch + 7:
+      handleStripButton(note - Mackie::ChannelStrip::Fader::Touch, StripButton::Touch, on);
+      break;
+
+    case Mackie::Main::Touch:
+      handleTouch(on);
+      break;
+
+#if V2MACKIE_TRANSPORT
+    case Mackie::Transport::Rewind:
+      handleTransportButton(TransportButton::Rewind, on);
+      break;
+
+    case Mackie::Transport::Forward:
+      handleTransportButton(TransportButton::Forward, on);
+      break;
+
+    case Mackie::Transport::Stop:
+      handleTransportButton(TransportButton::Stop, on);
+      break;
+
+    case Mackie::Transport::Play:
+      handleTransportButton(TransportButton::Play, on);
+      break;
+
+    case Mackie::Transport::Record:
+      handleTransportButton(TransportButton::Record, on);
+      break;
+#endif
+
+    case Mackie::Bank::Previous:
+      handleBankButton(BankButton::Previous, on);
+      break;
+
+    case Mackie::Bank::Next:
+      handleBankButton(BankButton::Next, on);
+      break;
+
+    case Mackie::Bank::PreviousChannel:
+      handleBankButton(BankButton::PreviousChannel, on);
+      break;
+
+    case Mackie::Bank::NextChannel:
+      handleBankButton(BankButton::NextChannel, on);
+      break;
+
+    case Mackie::Bank::Flip:
+      handleBankButton(BankButton::Flip, on);
+      break;
+
+    case Mackie::Bank::Edit:
+      handleBankButton(BankButton::Edit, on);
+      break;
+
+    case Mackie::Function::F1... Mackie::Function::F16:
+      handleFunctionButton(note - Mackie::Function::F1, on);
+      break;
+
+    case Mackie::Modifier::Shift:
+      handleModifierButton(ModifierButton::Shift, on);
+      break;
+
+    case Mackie::Modifier::Option:
+      handleModifierButton(ModifierButton::Option, on);
+      break;
+
+    case Mackie::Modifier::Control:
+      handleModifierButton(ModifierButton::Control, on);
+      break;
+
+    case Mackie::Modifier::Alt:
+      handleModifierButton(ModifierButton::Alt, on);
+      break;
+
+    case Mackie::Automation::On:
+      handleAutomationButton(AutomationButton::On, on);
+      break;
+
+    case Mackie::Automation::Record:
+      handleAutomationButton(AutomationButton::Record, on);
+      break;
+
+    case Mackie::Automation::Snapshot:
+      handleAutomationButton(AutomationButton::Snapshot, on);
+      break;
+
+    case Mackie::Automation::Touch:
+      handleAutomationButton(AutomationButton::Touch, on);
+      break;
+
+    case Mackie::Utility::Undo:
+      handleUtilityButton(UtilityButton::Undo, on);
+      break;
+
+    case Mackie::Utility::Redo:
+      handleUtilityButton(UtilityButton::Redo, on);
+      break;
+
+    case Mackie::Utility::Cancel:
+      handleUtilityButton(UtilityButton::Cancel, on);
+      break;
+
+    case Mackie::Utility::Enter:
+      handleUtilityButton(UtilityButton::Enter, on);
+      break;
+
+    case Mackie::Utility::Marker:
+      handleUtilityButton(UtilityButton::Marker, on);
+      break;
+
+    case Mackie::Utility::Mixer:
+      handleUtilityButton(UtilityButton::Mixer, on);
+      break;
+
+    case Mackie::Marker::PreviousFrame:
+      handleMarkerButton(MarkerButton::PreviousFrame, on);
+      break;
+
+    case Mackie::Marker::NextFrame:
+      handleMarkerButton(MarkerButton::NextFrame, on);
+      break;
+
+    case Mackie::Marker::Loop:
+      handleMarkerButton(MarkerButton::Loop, on);
+      break;
+
+    case Mackie::Marker::PointIn:
+      handleMarkerButton(MarkerButton::PointIn, on);
+      break;
+
+    case Mackie::Marker::PointOut:
+      handleMarkerButton(MarkerButton::PointOut, on);
+      break;
+
+    case Mackie::Marker::Home:
+      handleMarkerButton(MarkerButton::Home, on);
+      break;
+
+    case Mackie::Marker::End:
+      handleMarkerButton(MarkerButton::End, on);
+      break;
+
+    case Mackie::Navigation::Up:
+      handleNavigationButton(NavigationButton::Up, on);
+      break;
+
+    case Mackie::Navigation::Down:
+      handleNavigationButton(NavigationButton::Down, on);
+      break;
+
+    case Mackie::Navigation::Left:
+      handleNavigationButton(NavigationButton::Left, on);
+      break;
+
+    case Mackie::Navigation::Right:
+      handleNavigationButton(NavigationButton::Right, on);
+      break;
+
+    case Mackie::Navigation::Zoom:
+      handleNavigationButton(NavigationButton::Zoom, on);
+      break;
+
+    case Mackie::Navigation::Scrub:
+      handleNavigationButton(NavigationButton::Scrub, on);
+      break;
+
+    case Mackie::UserSwitch::S1... Mackie::UserSwitch::S2:
+      handleUserSwitch(note - Mackie::UserSwitch::S1, on);
+      break;
+  }
+}
+
+void V2Mackie::notifyStripFader(uint8_t strip) {
+  if (pushEvent(Event::Type::StripFader, strip, 0))
+    return;
+
+  if (addStripChange(strip, StripChange::Fader))
+    return;
+
+  V2MACKIE_HANDLER(StripFader);
+  handleStripFader(strip, _strips[strip].fader.position);
+}
+
+void V2Mackie::notifyFader() {
+  if (pushEvent(Event::Type::Fader, 0, 0))
+    return;
+
+  V2MACKIE_HANDLER(Fader);
+  handleFader(_main.fader.position);
+}
+
+#if V2MACKIE_VPOT
+void V2Mackie::notifyStripVPot(uint8_t strip) {
+  if (pushEvent(Event::Type::StripVPot, strip, _strips[strip].vpot.led))
+    return;
+
+  if (addStripChange(strip, StripChange::VPot))
+    return;
+
+  V2MACKIE_HANDLER(StripVPot);
+  const auto *vpot = &_strips[strip].vpot;
+  handleStripVPotDisplay(strip, vpot->led);
+  handleStripVPotDisplay(strip, vpot->mode, vpot->center, vpot->value);
+}
+#endif
+
+#if V2MACKIE_METER
+void V2Mackie::notifyStripMeter(uint8_t strip, bool overload) {
+  if (pushEvent(Event::Type::StripMeter, strip, 0))
+    return;
+
+  if (addStripChange(strip, StripChange::Meter))
+    return;
+
+  V2MACKIE_HANDLER(StripMeter);
+  if (overload)
+    handleStripMeterOverload(strip, _strips[strip].meter.overload);
+
+  handleStripMeter(strip, _strips[strip].meter.fraction, _strips[strip].meter.overload);
+}
+#endif
+
+#if V2MACKIE_DISPLAY
+void V2Mackie::notifyStripDisplay(bool global, uint8_t strip, uint8_t row) {
+  if (pushEvent(Event::Type::StripDisplay, (row * 8) + strip, global))
+    return;
+
+  if (addStripChange(strip, row == 0 ? StripChange::DisplayRow0 : StripChange::DisplayRow1))
+    return;
+
+  V2MACKIE_HANDLER(StripDisplay);
+  handleStripDisplay(global, strip, row);
+}
+
+void V2Mackie::notifyDisplayGlobal(uint8_t row) {
+  const bool global = isDisplayGlobal(row);
+
+  if (pushEvent(Event::Type::DisplayGlobal, row, global))
+    return;
+
+  V2MACKIE_HANDLER(DisplayGlobal);
+  handleDisplayGlobal(row, global);
+}
+
+void V2Mackie::notifyDisplay(const bool global[2], uint16_t cells) {
+  // The events and the change sets carry the individual cells.
+#if V2MACKIE_EVENTS
+  if (_events.enabled)
+    return;
+#endif
+
+#if V2MACKIE_FRAMES
+  if (_frame.fps > 0)
+    return;
+#endif
+
+  V2MACKIE_HANDLER(Display);
+  handleDisplay(cells);
+
+  for (uint8_t row = 0; row < 2; row++) {
+    const uint8_t strips = cells >> (8 * row);
+    if (strips != 0)
+      handleDisplayRow(global[row], row, strips);
+  }
+}
+#endif
+
+#if V2MACKIE_TIME
+void V2Mackie::notifyTime() {
+  if (pushEvent(Event::Type::Time, 0, (uint16_t)_time.type))
+    return;
+
+  V2MACKIE_HANDLER(Time);
+  handleTime(_time.type);
+}
+#endif
+
+void V2Mackie::notifyPing() {
+  if (pushEvent(Event::Type::Ping, 0, 0))
+    return;
+
+  V2MACKIE_HANDLER(Ping);
+  handlePing();
+}
+
+void V2Mackie::notifyTimeout() {
+  if (pushEvent(Event::Type::Timeout, 0, 0))
+    return;
+
+  V2MACKIE_HANDLER(Timeout);
+  handleTimeout();
+}
+
+void V2Mackie::notifyLEDs() {
+  if (pushEvent(Event::Type::LEDs, 0, 0))
+    return;
+
+  V2MACKIE_HANDLER(LEDs);
+  handleLEDs(_leds.frame);
+}
+
+void V2Mackie::dispatchNote(uint8_t channel, uint8_t note, uint8_t velocity) {
+  switch (channel) {
+    case 0: {
+      LED led;
+      switch (velocity) {
+        case 0:
+          led = LED::Off;
+          break;
+
+        case 1:
+          led = LED::Blink;
+          break;
+
+        default:
+          led = LED::On;
+          break;
+      }
+
+      setButtonState(note, led);
+
+      switch (note) {
+        case Mackie::ChannelStrip::Fader::Touch... Mackie::ChannelStrip::Fader::Touch + 7: {
+          const uint8_t strip = note - Mackie::ChannelStrip::Fader::Touch;
+          const bool resync   = touchFader(&_strips[strip].fader, note, led != LED::Off);
+          notifyButton(note, led);
+          if (resync)
+            notifyStripFader(strip);
         } break;
 
-        case Mackie::Navigation::Scrub: {
-          const bool on = velocity == 127;
-          handleNavigationButton(NavigationButton::Scrub, on);
+        case Mackie::Main::Touch: {
+          const bool resync = touchFader(&_main.fader, note, led != LED::Off);
+          notifyButton(note, led);
+          if (resync)
+            notifyFader();
         } break;
+
+        default:
+          if (!_leds.frames)
+            notifyButton(note, led);
+          break;
       }
     } break;
 
     case 15:
       switch (note) {
         case Mackie::Protocol::Ping:
-          _active_usec = micros();
+          updateLink();
+          notifyPing();
           break;
       }
       break;
@@ -780,69 +1329,56 @@ void V2Mackie::dispatchControlChange(uint8_t channel, uint8_t controller, uint8_
     return;
 
   switch (controller) {
+#if V2MACKIE_TIME
     case Mackie::Display::Time::Digit... Mackie::Display::Time::Digit + 9:
-      _display.time.digits[Mackie::Display::Time::Digit + 9 - controller] = value;
-      handleTime(_display.time.type);
+      _time.digits[Mackie::Display::Time::Digit + 9 - controller] = value;
+      notifyTime();
       break;
+#endif
 
+#if V2MACKIE_VPOT
     case Mackie::ChannelStrip::VPot::LED... Mackie::ChannelStrip::VPot::LED + 7: {
       const uint8_t strip    = controller - Mackie::ChannelStrip::VPot::LED;
-      const bool center      = value & 0x40;
       const uint8_t position = value & 0x0f;
-
-      handleStripVPotDisplay(strip, value);
+      auto *vpot             = &_strips[strip].vpot;
+      vpot->led              = value;
+      vpot->center           = value & 0x40;
 
       if (position == 0) {
-        _strips[strip].vpot.mode   = VPotMode::Off;
-        _strips[strip].vpot.center = center;
-        _strips[strip].vpot.value  = 0;
-        handleStripVPotDisplay(strip, VPotMode::Off, center, 0);
-        return;
+        vpot->mode  = VPotMode::Off;
+        vpot->value = 0;
+
+      } else {
+        switch ((value >> 4) & 3) {
+          case Mackie::ChannelStrip::VPot::Single:
+            vpot->mode  = VPotMode::Bar;
+            vpot->value = (float)position / 11.f;
+            break;
+
+          case Mackie::ChannelStrip::VPot::Boost:
+            vpot->mode = VPotMode::Pan;
+            if (position < 6)
+              vpot->value = (float)(6 - position) / -5.f;
+
+            else
+              vpot->value = (float)(position - 6) / 5.f;
+            break;
+
+          case Mackie::ChannelStrip::VPot::Bar:
+            vpot->mode  = VPotMode::Bar;
+            vpot->value = (float)position / 11.f;
+            break;
+
+          case Mackie::ChannelStrip::VPot::Spread:
+            vpot->mode  = VPotMode::Bar;
+            vpot->value = (float)position / 6.f;
+            break;
+        }
       }
 
-      switch ((value >> 4) & 3) {
-        case Mackie::ChannelStrip::VPot::Single: {
-          const float fraction       = (float)position / 11.f;
-          _strips[strip].vpot.mode   = VPotMode::Bar;
-          _strips[strip].vpot.center = center;
-          _strips[strip].vpot.value  = fraction;
-          handleStripVPotDisplay(strip, VPotMode::Bar, center, fraction);
-        } break;
-
-        case Mackie::ChannelStrip::VPot::Boost: {
-          if (position < 6) {
-            float fraction             = (float)(6 - position) / -5.f;
-            _strips[strip].vpot.mode   = VPotMode::Pan;
-            _strips[strip].vpot.center = center;
-            _strips[strip].vpot.value  = fraction;
-            handleStripVPotDisplay(strip, VPotMode::Pan, center, fraction);
-
-          } else {
-            float fraction             = (float)(position - 6) / 5.f;
-            _strips[strip].vpot.mode   = VPotMode::Pan;
-            _strips[strip].vpot.center = center;
-            _strips[strip].vpot.value  = fraction;
-            handleStripVPotDisplay(strip, VPotMode::Pan, center, fraction);
-          }
-        } break;
-
-        case Mackie::ChannelStrip::VPot::Bar: {
-          const float fraction       = (float)position / 11.f;
-          _strips[strip].vpot.mode   = VPotMode::Bar;
-          _strips[strip].vpot.center = center;
-          _strips[strip].vpot.value  = fraction;
-          handleStripVPotDisplay(strip, VPotMode::Bar, center, fraction);
-        } break;
-
-        case Mackie::ChannelStrip::VPot::Spread: {
-          const float fraction       = (float)position / 6.f;
-          _strips[strip].vpot.mode   = VPotMode::Bar;
-          _strips[strip].vpot.center = center;
-          _strips[strip].vpot.value  = fraction;
-          handleStripVPotDisplay(strip, VPotMode::Bar, center, fraction);
-        } break;
-      }
+      notifyStripVPot(strip);
     } break;
+#endif
 
     case V2MIDI::CC::AllSoundOff:
     case V2MIDI::CC::AllNotesOff:
@@ -851,6 +1387,7 @@ void V2Mackie::dispatchControlChange(uint8_t channel, uint8_t controller, uint8_
   }
 }
 
+#if V2MACKIE_METER
 void V2Mackie::dispatchAftertouchChannel(uint8_t channel, uint8_t pressure) {
   if (channel != 0)
     return;
@@ -860,33 +1397,67 @@ void V2Mackie::dispatchAftertouchChannel(uint8_t channel, uint8_t pressure) {
     return;
 
   const uint8_t value = pressure & 0xf;
+  bool overload       = false;
   switch (value) {
     case 0 ... 12:
       _strips[index].meter.fraction = (float)value / 12.f;
+      updateMeter(index, value);
       break;
 
     case 13:
       // TotalMix sends value == 13. This is not the original format wich was
       // driving 12 LEDs and a separate overload indicator.
       _strips[index].meter.fraction = 1;
+      updateMeter(index, 12);
       break;
 
     case 14:
       // Setting/clearing 'overload' does not reset the current meter value.
-      if (!_strips[index].meter.overload)
-        handleStripMeterOverload(index, true);
+      overload                      = !_strips[index].meter.overload;
       _strips[index].meter.overload = true;
       break;
 
     case 15:
-      if (_strips[index].meter.overload)
-        handleStripMeterOverload(index, false);
+      overload                      = _strips[index].meter.overload;
       _strips[index].meter.overload = false;
       break;
   }
 
-  _strips[index].meter.usec = micros();
-  handleStripMeter(index, _strips[index].meter.fraction, _strips[index].meter.overload);
+  _strips[index].meter.usec = getMicros();
+  _meters.ages &= ~(0xfUL << (index * 4));
+  notifyStripMeter(index, overload);
+}
+#endif
+
+// Returns true if the host position should be delivered.
+bool V2Mackie::updateFader(Fader *fader, uint8_t touch, float fraction) {
+  fader->position = fraction;
+
+  // The host echoes the sent position, the value might be quantized.
+  bool echo = false;
+  if (fader->usec > 0 && (unsigned long)(getMicros() - fader->usec) < 500 * 1000) {
+    const float delta = fraction - fader->sent;
+    echo              = delta > -0.005f && delta < 0.005f;
+  }
+
+  // Do not fight the hand, deliver the last position after the release.
+  if (getButton(touch)) {
+    fader->resync = !echo;
+    return false;
+  }
+
+  return !echo;
+}
+
+// Returns true if the last host position needs to be delivered.
+bool V2Mackie::touchFader(Fader *fader, uint8_t touch, bool on) {
+  setButtonState(touch, on ? LED::On : LED::Off);
+  if (on)
+    return false;
+
+  const bool resync = fader->resync;
+  fader->resync     = false;
+  return resync;
 }
 
 void V2Mackie::dispatchPitchBend(uint8_t channel, int16_t value) {
@@ -901,18 +1472,33 @@ void V2Mackie::dispatchPitchBend(uint8_t channel, int16_t value) {
 
   switch (channel) {
     case 0 ... 7:
-      _strips[channel].fader.position = fraction;
-      handleStripFader(channel, fraction);
+      if (updateFader(&_strips[channel].fader, Mackie::ChannelStrip::Fader::Touch + channel, fraction))
+        notifyStripFader(channel);
       break;
 
     case 8:
-      _main.fader = fraction;
-      handleFader(fraction);
+      if (updateFader(&_main.fader, Mackie::Main::Touch, fraction))
+        notifyFader();
       break;
   }
 }
 
 void V2Mackie::dispatchPacket(V2MIDI::Packet *packet) {
+  V2MACKIE_TRACE_EVENT(PacketBegin, (uint8_t)packet->getType() | packet->getChannel(), 0);
+  beginUpdate();
+  _link.rate.count++;
+
+  if (_protocol == Protocol::HUI)
+    dispatchHUIPacket(packet);
+
+  else
+    dispatchMackiePacket(packet);
+
+  endUpdate();
+  V2MACKIE_TRACE_EVENT(PacketEnd, 0, 0);
+}
+
+void V2Mackie::dispatchMackiePacket(V2MIDI::Packet *packet) {
   switch (packet->getType()) {
     case V2MIDI::Packet::Status::NoteOn:
       dispatchNote(packet->getChannel(), packet->getNote(), packet->getNoteVelocity());
@@ -926,9 +1512,11 @@ void V2Mackie::dispatchPacket(V2MIDI::Packet *packet) {
       dispatchControlChange(packet->getChannel(), packet->getController(), packet->getControllerValue());
       break;
 
+#if V2MACKIE_METER
     case V2MIDI::Packet::Status::AftertouchChannel:
       dispatchAftertouchChannel(packet->getChannel(), packet->getAftertouchChannel());
       break;
+#endif
 
     case V2MIDI::Packet::Status::PitchBend:
       dispatchPitchBend(packet->getChannel(), packet->getPitchBend());
@@ -937,12 +1525,30 @@ void V2Mackie::dispatchPacket(V2MIDI::Packet *packet) {
 }
 
 void V2Mackie::dispatchSystemExclusive(const uint8_t *buffer, uint32_t len) {
+  V2MACKIE_TRACE_EVENT(SystemExclusiveBegin, 0, len > 0xffff ? 0xffff : len);
+  beginUpdate();
+  _link.rate.count++;
+
+  if (_protocol == Protocol::HUI)
+    dispatchHUISystemExclusive(buffer, len);
+
+  else
+    dispatchMackieSystemExclusive(buffer, len);
+
+  endUpdate();
+  V2MACKIE_TRACE_EVENT(SystemExclusiveEnd, 0, 0);
+}
+
+void V2Mackie::dispatchMackieSystemExclusive(const uint8_t *buffer, uint32_t len) {
+  // Start byte, header, at least one byte like the Display index, end byte.
   if (len < 1 + Mackie::Message::Header::Message + 1 + 1)
     return;
 
   // Remove SysEx start and end byte.
   const uint8_t *p = buffer + 1;
-  uint32_t l       = len - 2;
+#if V2MACKIE_DISPLAY
+  uint32_t l = len - 2;
+#endif
 
   if (memcmp(p + Mackie::Message::Header::Vendor, Mackie::Message::Vendor, sizeof(Mackie::Message::Vendor)) != 0)
     return;
@@ -952,13 +1558,11 @@ void V2Mackie::dispatchSystemExclusive(const uint8_t *buffer, uint32_t len) {
     return;
 
   switch (p[Mackie::Message::Header::Type]) {
+#if V2MACKIE_DISPLAY
     case Mackie::Message::Type::Display: {
       p += Mackie::Message::Header::Message;
       l -= Mackie::Message::Header::Message;
 
-      if (len < Mackie::Message::Display::Header::Text + 1)
-        break;
-
       // TotalMix: Strip 1, row 1
       // F0 00 00 66 14 12 00 41 4E 20 31 2F 32 20 F7     |   f   AN 1/2  |
 
@@ -992,45 +1596,12 @@ void V2Mackie::dispatchSystemExclusive(const uint8_t *buffer, uint32_t len) {
       p += Mackie::Message::Display::Header::Text;
       l -= Mackie::Message::Display::Header::Text;
 
-      if (start + l > sizeof(_display.strip))
+      if (l > sizeof(_display.strip) || start + l > sizeof(_display.strip))
         return;
 
       memcpy(_display.strip + start, p, l);
-
-      // Try to guess if the display rows are used to show a global message which
-      // is not related to the associated channel strips; check if any of the separating
-      // spaces are overwritten.
-      bool global[2]{};
-      for (uint8_t i = 0; i < 8; i++) {
-        if (_display.strip[(i * 7) + 6] != ' ') {
-          global[0] = true;
-          break;
-        }
-      }
-      for (uint8_t i = 8; i < 16; i++) {
-        if (_display.strip[(i * 7) + 6] != ' ') {
-          global[1] = true;
-          break;
-        }
-      }
-
-      // Generate per-strip/row events.
-      const uint8_t first = start / 7;          // First of the 16 7-character ranges.
-      const uint8_t last  = (start + l) / 7;    // Last of the 16 7-character ranges.
-      const uint8_t count = 1 + (last - first); // Number of 7-character ranges.
-
-      for (uint8_t i = 0; i < count; i++) {
-        const uint8_t strip = (first + i) % 8;
-        const uint8_t row   = (first + i) / 8;
-
-        // Has the content changed?
-        if (memcmp(_display.strip + (56 * row) + (7 * strip), _strips[strip].display[row], 7) == 0)
-          continue;
-
-        // Update copy and notify.
-        memcpy(_strips[strip].display[row], _display.strip + (56 * row) + (7 * strip), 7);
-        handleStripDisplay(global[row], strip, row);
-      }
+      updateDisplay(start, l);
     } break;
+#endif
   }
 }
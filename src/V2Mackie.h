@@ -5,8 +5,120 @@
 
 #include <V2MIDI.h>
 
+// The configuration of the build, every flag is 0 or 1. The flags change the
+// layout of the class and its virtual functions; they must be the same in
+// every translation unit, the library sources included. A mismatch fails to
+// link with an undefined V2Mackie::V2MackieConfig_* function.
+//
+// Set them globally, either with build flags (-DV2MACKIE_TRACE=1), or in a
+// V2MackieConfig.h header which is found in the include path of the library.
+// The Arduino IDE does not pass a sketch's #defines to the libraries; put the
+// header into its own library folder (libraries/V2MackieConfig/V2MackieConfig.h)
+// and include it in the sketch before V2Mackie.h.
+#if __has_include(<V2MackieConfig.h>)
+#include <V2MackieConfig.h>
+#endif
+
+// The subsystems; a disabled one removes its state, handlers and message
+// dispatch. The static set*() functions are not affected, unused ones are
+// dropped by the linker.
+#ifndef V2MACKIE_DISPLAY
+#define V2MACKIE_DISPLAY 1
+#endif
+
+#ifndef V2MACKIE_TIME
+#define V2MACKIE_TIME 1
+#endif
+
+#ifndef V2MACKIE_METER
+#define V2MACKIE_METER 1
+#endif
+
+#ifndef V2MACKIE_VPOT
+#define V2MACKIE_VPOT 1
+#endif
+
+#ifndef V2MACKIE_TRANSPORT
+#define V2MACKIE_TRANSPORT 1
+#endif
+
+// Features which a simple device can disable to save memory.
+
+// The prioritized output queue with bandwidth limit, send() and sendText().
+#ifndef V2MACKIE_OUTPUT
+#define V2MACKIE_OUTPUT 1
+#endif
+
+// The event queue, setEvents() and getEvent().
+#ifndef V2MACKIE_EVENTS
+#define V2MACKIE_EVENTS 1
+#endif
+
+// The change sets, setFrameRate() and handleStripChanges().
+#ifndef V2MACKIE_FRAMES
+#define V2MACKIE_FRAMES 1
+#endif
+
+// The state for a reader on a different core, getSnapshot() and getDisplayPage().
+#ifndef V2MACKIE_SNAPSHOT
+#define V2MACKIE_SNAPSHOT 1
+#endif
+
+// Diagnostics, disabled by default.
+
+// The duration of the handler calls, getProfile().
+#ifndef V2MACKIE_PROFILE
+#define V2MACKIE_PROFILE 0
+#endif
+
+// The recent activity, getTrace(); a ring buffer of V2MACKIE_TRACE_SIZE records.
+#ifndef V2MACKIE_TRACE
+#define V2MACKIE_TRACE 0
+#endif
+
+#ifndef V2MACKIE_TRACE_SIZE
+#define V2MACKIE_TRACE_SIZE 256
+#endif
+
+// Profile and trace the handler calls until the end of the scope.
+#if V2MACKIE_PROFILE || V2MACKIE_TRACE
+#define V2MACKIE_HANDLER(handler) HandlerScope handlerScope(this, Handler::handler)
+#else
+#define V2MACKIE_HANDLER(handler)
+#endif
+
+// Record an entry in the trace.
+#if V2MACKIE_TRACE
+#define V2MACKIE_TRACE_EVENT(type, index, value) addTrace(Trace::Type::type, index, value)
+#else
+#define V2MACKIE_TRACE_EVENT(type, index, value)
+#endif
+
+// The configuration as a function name; the library defines it, begin()
+// calls it.
+#define V2MACKIE_CONFIG_NAME(d, t, m, v, x, o, e, f, s, p, r) V2MackieConfig_##d##t##m##v##x##o##e##f##s##p##r
+#define V2MACKIE_CONFIG_EXPAND(d, t, m, v, x, o, e, f, s, p, r) V2MACKIE_CONFIG_NAME(d, t, m, v, x, o, e, f, s, p, r)
+#define V2MACKIE_CONFIG                                                                                                \
+  V2MACKIE_CONFIG_EXPAND(V2MACKIE_DISPLAY,                                                                             \
+                         V2MACKIE_TIME,                                                                                \
+                         V2MACKIE_METER,                                                                               \
+                         V2MACKIE_VPOT,                                                                                \
+                         V2MACKIE_TRANSPORT,                                                                           \
+                         V2MACKIE_OUTPUT,                                                                              \
+                         V2MACKIE_EVENTS,                                                                              \
+                         V2MACKIE_FRAMES,                                                                              \
+                         V2MACKIE_SNAPSHOT,                                                                            \
+                         V2MACKIE_PROFILE,                                                                             \
+                         V2MACKIE_TRACE)
+
 class V2Mackie {
 public:
+  // The wire protocol; both protocols share the same state and handlers.
+  enum class Protocol {
+    Mackie,
+    HUI,
+  };
+
   enum class StripButton {
     Arm,
     Mute,
@@ -49,6 +161,39 @@ public:
     Scrub,
   };
 
+  enum class AutomationButton {
+    On,
+    Record,
+    Snapshot,
+    Touch,
+  };
+
+  enum class UtilityButton {
+    Undo,
+    Redo,
+    Cancel,
+    Enter,
+    Marker,
+    Mixer,
+  };
+
+  enum class MarkerButton {
+    PreviousFrame,
+    NextFrame,
+    Loop,
+    PointIn,
+    PointOut,
+    Home,
+    End,
+  };
+
+  // Button LEDs; the velocity of the note: 0 == off, 1 == blink, 127 == on.
+  enum class LED {
+    Off,
+    Blink,
+    On,
+  };
+
   enum class VPotMode {
     Off,
     Pan,
@@ -78,17 +223,344 @@ public:
   };
 
   void begin() {
+    V2MACKIE_CONFIG();
     reset();
   }
 
   void reset();
   void loop();
+
+  Protocol getProtocol() {
+    return _protocol;
+  }
+
+  // Switching the protocol resets the current state.
+  void setProtocol(Protocol protocol) {
+    _protocol = protocol;
+    reset();
+  }
+
   void dispatchPacket(V2MIDI::Packet *packet);
   void dispatchSystemExclusive(const uint8_t *buffer, uint32_t len);
 
+  // The state of all buttons/LEDs, indexed by note number. A blinking LED is on.
+  bool getButton(uint8_t note) {
+    if (note > 127)
+      return false;
+
+    return _buttons[note / 32] & (1UL << (note % 32));
+  }
+
+  // 128 bits, 4 words of 32 bits.
+  const uint32_t *getButtons() {
+    return _buttons;
+  }
+
+  LED getLED(uint8_t note) {
+    if (!getButton(note))
+      return LED::Off;
+
+    if (_leds.blink[note / 32] & (1UL << (note % 32)))
+      return LED::Blink;
+
+    return LED::On;
+  }
+
+  // The currently visible LEDs, the blinking LEDs toggle with a shared phase.
+  const uint32_t *getLEDs() {
+    return _leds.frame;
+  }
+
+  // Deliver the LEDs only as frames with handleLEDs(); the host's LED
+  // messages no longer raise handleButton() and the typed button handlers.
+  // The fader touch notes are states and are always delivered.
+  void setLEDFrames(bool on) {
+    _leds.frames = on;
+  }
+
+  bool getStripButton(uint8_t strip, StripButton button) {
+    return getButton(getStripButtonNote(button) + strip);
+  }
+
+  float getStripFader(uint8_t strip) {
+    return _strips[strip].fader.position;
+  }
+
+  float getFader() {
+    return _main.fader.position;
+  }
+
+#if V2MACKIE_VPOT
+  VPotMode getStripVPot(uint8_t strip, bool &center, float &fraction) {
+    center   = _strips[strip].vpot.center;
+    fraction = _strips[strip].vpot.value;
+    return _strips[strip].vpot.mode;
+  }
+#endif
+
+#if V2MACKIE_METER
+  float getStripMeter(uint8_t strip, bool &overload) {
+    overload = _strips[strip].meter.overload;
+    return _strips[strip].meter.fraction;
+  }
+
+  // The held peak, the current level if peak hold is not enabled.
+  float getStripMeterPeak(uint8_t strip) {
+    if (_meters.hold == 0)
+      return _strips[strip].meter.fraction;
+
+    return (float)((_meters.peaks >> (strip * 4)) & 0xf) / 12.f;
+  }
+
+  // Meter processing of all strips at once, the levels are stored in 4-bit
+  // lanes of a single word. With every tick, the levels fall by one step if
+  // 'decay' is set, a peak is held for 'hold' ticks, and a level which is not
+  // updated for 'timeout' ticks is cleared; the counts are limited to 15 ticks.
+  // A tick of 0 disables it and peak hold, meters are cleared after one
+  // second without an update. The lanes cover the 8 strips of this device;
+  // every extender is a separate instance with its own lanes.
+  void setMeterProcessing(uint16_t tickMsec, bool decay = false, uint8_t hold = 0, uint8_t timeout = 10);
+#endif
+
+#if V2MACKIE_TIME
   void getTime(Time &time);
+#endif
+
+#if V2MACKIE_DISPLAY
   void getStripDisplay(uint8_t strip, uint8_t row, char text[8]);
 
+  // The 7 characters of a cell in the display, NUL-terminated.
+  const char *getStripText(uint8_t strip, uint8_t row) {
+    return _strips[strip].display[row].text;
+  }
+
+  // If the row shows a global message which is not related to the associated
+  // channel strips; the separating spaces between the cells are overwritten.
+  bool isDisplayGlobal(uint8_t row) {
+    return _display.separators[row] != 0;
+  }
+
+  // The cell in the display and its length without trailing spaces.
+  const char *getStripText(uint8_t strip, uint8_t row, uint8_t &len) {
+    len = _strips[strip].length[row];
+    return getStripText(strip, row);
+  }
+#endif
+
+#if V2MACKIE_SNAPSHOT
+  // A consistent copy of the state, for a reader running on a different core
+  // than the one dispatching the messages. The state is protected by a
+  // sequence counter; the copy is retried if it was updated meanwhile.
+  //
+  // The snapshot and the display page support one reader. The two cores
+  // share only aligned 32-bit loads and stores and memory barriers, no
+  // read-modify-write operations; that works on cores without atomic
+  // instructions, like the Cortex-M0+ of the RP2040.
+  struct Snapshot {
+    struct {
+#if V2MACKIE_DISPLAY
+      char display[2][8];
+#endif
+
+#if V2MACKIE_VPOT
+      struct {
+        VPotMode mode;
+        bool center;
+        float fraction;
+      } vpot;
+#endif
+
+      float fader;
+#if V2MACKIE_METER
+      float meter;
+      bool overload;
+#endif
+    } strips[8];
+
+#if V2MACKIE_DISPLAY
+    bool global[2];
+#endif
+    float fader;
+    uint32_t buttons[4];
+#if V2MACKIE_TIME
+    Time time;
+#endif
+  };
+
+  // Returns false if the state was still updated after all tries. It must not
+  // be called from the handlers, the state is updated while they run.
+  bool getSnapshot(Snapshot &snapshot, uint8_t tries = 16);
+
+  // The number of copies which were retried.
+  uint32_t getSnapshotRetries() {
+    return __atomic_load_n(&_snapshot.retries, __ATOMIC_RELAXED);
+  }
+#endif
+
+#if V2MACKIE_DISPLAY
+  // A cell of the display, 7 characters and a NUL; compared and copied as a
+  // single word.
+  union Cell {
+    uint64_t word;
+    char text[8];
+  };
+
+#if V2MACKIE_SNAPSHOT
+  // The display for a renderer running on a different core than the one
+  // dispatching the messages; a new page is published after every Display
+  // message. The 16 cells, row 0 followed by row 1, are not modified until
+  // the next call. 'cells' returns the cells changed since the last call.
+  const Cell *getDisplayPage(uint16_t &cells);
+#endif
+#endif
+
+  // The handler calls, grouped by the type of the change.
+  enum class Handler : uint8_t {
+    Button,
+    StripFader,
+    Fader,
+    StripVPot,
+    StripMeter,
+    StripDisplay,
+    DisplayGlobal,
+    Display,
+    StripChanges,
+    Time,
+    LEDs,
+    Ping,
+    Timeout,
+    Send,
+    _count,
+  };
+
+#if V2MACKIE_PROFILE
+  // The duration of the handler calls.
+  struct Profile {
+    struct {
+      uint32_t count;
+      uint32_t min;
+      uint32_t max;
+      uint64_t total;
+
+      // Bucket n counts the durations shorter than 2^n microseconds, the last
+      // bucket all longer ones.
+      uint32_t histogram[12];
+    } handlers[(uint8_t)Handler::_count];
+  };
+
+  const Profile &getProfile() {
+    return _profile;
+  }
+
+  void resetProfile() {
+    _profile = {};
+  }
+
+  // A line per called handler: name, count, min/avg/max microseconds and the
+  // histogram. Returns the length of the text.
+  uint32_t printProfile(char *text, uint32_t size);
+#endif
+
+#if V2MACKIE_TRACE
+  // The recent activity, a ring buffer of V2MACKIE_TRACE_SIZE records. The
+  // records can be converted to the Chrome trace format with the script in
+  // extras/.
+  struct Trace {
+    enum class Type : uint8_t {
+      PacketBegin,          // index: status
+      PacketEnd,            //
+      SystemExclusiveBegin, // value: length
+      SystemExclusiveEnd,   //
+      HandlerBegin,         // index: Handler
+      HandlerEnd,           // index: Handler
+      LoopBegin,            //
+      LoopEnd,              //
+      MeterTimeout,         // index: strip
+      Timeout,              //
+    };
+
+    struct Record {
+      uint32_t usec;
+      Type type;
+      uint8_t index;
+      uint16_t value;
+    };
+  };
+
+  // Copies the recorded entries, the oldest first; returns the number of records.
+  uint16_t readTrace(Trace::Record *records, uint16_t count);
+#endif
+
+  // The MIDI bytes of a channel message; returns the length, 0 for other messages.
+  static uint8_t getMessage(V2MIDI::Packet *packet, uint8_t message[3]);
+
+  // The button, controller or channel a message addresses; messages with the
+  // same target replace each other. Note Off and Note On address the same note.
+  static uint16_t getMessageTarget(const uint8_t message[3]);
+
+  // The fader of a position or touch message; 0..7 strips, 8 main, -1 for
+  // others. The position of a fader is not reordered with its touch.
+  static int8_t getMessageFader(const uint8_t message[3]);
+
+  // Events, an alternative to the handle*() functions. If enabled, changes are
+  // queued instead of calling the handlers, and the application reads them
+  // with getEvent() on its own schedule. A pending event with the same type
+  // and index is updated instead of queueing a new one; an event identifies
+  // the change, the current state is read with the get*() functions.
+  struct Event {
+    enum class Type : uint8_t {
+      Button,        // index: note, value: LED
+      StripFader,    // index: strip
+      Fader,         //
+      StripVPot,     // index: strip, value: LED ring
+      StripMeter,    // index: strip
+      StripDisplay,  // index: row * 8 + strip, value: global
+      DisplayGlobal, // index: row, value: global
+      Time,          // value: Time::Type
+      LEDs,          //
+      Ping,          //
+      Timeout,       //
+    } type;
+    uint8_t index;
+    uint16_t value;
+  };
+
+#if V2MACKIE_EVENTS
+  void setEvents(bool on) {
+    _events.enabled = on;
+    _events.count   = 0;
+  }
+
+  // Returns false if no event is pending.
+  bool getEvent(Event &event);
+
+  // The number of events which did not fit into the queue.
+  uint32_t getEventsLost() {
+    return _events.lost;
+  }
+#endif
+
+  // Change sets; if a frame rate is set, changes of the visible strip state are
+  // not delivered with the individual handlers, but collected and delivered
+  // once per frame with handleStripChanges(). A rate of 0 disables it.
+  struct StripChange {
+    enum {
+      DisplayRow0 = 1 << 0,
+      DisplayRow1 = 1 << 1,
+      VPot        = 1 << 2,
+      Meter       = 1 << 3,
+      Fader       = 1 << 4,
+      Buttons     = 1 << 5,
+    };
+  };
+
+#if V2MACKIE_FRAMES
+  void setFrameRate(uint8_t fps) {
+    _frame.fps = fps;
+    memset(_frame.changes, 0, sizeof(_frame.changes));
+  }
+#endif
+
   // Adjust the strip number in the current packet.
   static V2MIDI::Packet *setStripIndex(V2MIDI::Packet *packet, uint8_t strip);
 
@@ -100,110 +572,588 @@ public:
   static V2MIDI::Packet *setStripMeterOverload(V2MIDI::Packet *packet, uint8_t strip, bool overload);
   static uint8_t setStripText(uint8_t *buffer, uint8_t strip, uint8_t row, const char *text);
 
+  // Display message; the offset and the length are characters of the 2 x 56
+  // character display.
+  static uint8_t setDisplay(uint8_t *buffer, uint8_t offset, const char *text, uint8_t len);
+
+  // Encoder rotation, 1..63 steps, negative values rotate counter clockwise.
+  static V2MIDI::Packet *setStripVPot(V2MIDI::Packet *packet, uint8_t strip, int8_t steps);
+
   // Main volume fader.
   static V2MIDI::Packet *setFader(V2MIDI::Packet *packet, float fraction);
   static V2MIDI::Packet *setTouch(V2MIDI::Packet *packet, bool on);
 
+  // Like the set*() functions, but the local fader state is updated. Host
+  // positions are not delivered while the fader is touched, the last one is
+  // delivered after the release. Host echoes of sent positions are ignored.
+  // They update the state like dispatchPacket(), on the same core.
+  V2MIDI::Packet *sendStripFader(V2MIDI::Packet *packet, uint8_t strip, float fraction);
+  V2MIDI::Packet *sendStripTouch(V2MIDI::Packet *packet, uint8_t strip, bool on);
+  V2MIDI::Packet *sendFader(V2MIDI::Packet *packet, float fraction);
+  V2MIDI::Packet *sendTouch(V2MIDI::Packet *packet, bool on);
+
   // Main buttons.
   static V2MIDI::Packet *setTransportButton(V2MIDI::Packet *packet, TransportButton button, bool on);
   static V2MIDI::Packet *setBankButton(V2MIDI::Packet *packet, BankButton button, bool on);
   static V2MIDI::Packet *setModifierButton(V2MIDI::Packet *packet, ModifierButton button, bool on);
   static V2MIDI::Packet *setNavigationButton(V2MIDI::Packet *packet, NavigationButton button, bool on);
   static V2MIDI::Packet *setFunctionButton(V2MIDI::Packet *packet, uint8_t function, bool on);
+  static V2MIDI::Packet *setAutomationButton(V2MIDI::Packet *packet, AutomationButton button, bool on);
+  static V2MIDI::Packet *setUtilityButton(V2MIDI::Packet *packet, UtilityButton button, bool on);
+  static V2MIDI::Packet *setMarkerButton(V2MIDI::Packet *packet, MarkerButton button, bool on);
+  static V2MIDI::Packet *setUserSwitch(V2MIDI::Packet *packet, uint8_t index, bool on);
+
+  // Any button by its note number.
+  static V2MIDI::Packet *setButton(V2MIDI::Packet *packet, uint8_t note, bool on);
+
+  // Jog wheel rotation, 1..63 steps, negative values rotate counter clockwise.
+  static V2MIDI::Packet *setJog(V2MIDI::Packet *packet, int8_t steps);
+
+#if V2MACKIE_VPOT
+  // Encoder and jog wheel detents are accumulated and sent with the next call
+  // to getRotation(), a fast rotation results in a few multi-step messages.
+  void rotateStripVPot(uint8_t strip, int8_t steps) {
+    rotate(strip, steps);
+  }
+
+  void rotateJog(int8_t steps) {
+    rotate(8, steps);
+  }
+
+  // Multiply the steps of fast rotations.
+  void setRotationAcceleration(bool on) {
+    _rotation.acceleration = on;
+  }
+
+  // The next message of the accumulated rotations, NULL if nothing is pending.
+  V2MIDI::Packet *getRotation(V2MIDI::Packet *packet);
+#endif
+
+  // Bandwidth limit; bytes become available with the elapsed time. A rate of
+  // 0 disables the limit.
+  struct Budget {
+    uint16_t rate;
+    uint8_t bytes;
+    unsigned long usec;
+
+    // Consume the bytes if they are available at the time 'now'.
+    bool take(uint8_t n, unsigned long now);
+  };
+
+  // The display text to send; the changed 7-character cells are sent in
+  // Display messages of up to two consecutive cells. The initial content is
+  // zero, NUL is never a display character and every cell is sent at least
+  // once.
+  struct DisplayImage {
+    // The longest Display message, two cells; the size of the buffer of read().
+    static constexpr uint8_t MessageSize = 22;
+
+    char text[56 * 2];
+
+    // The 7-character cells to send.
+    uint16_t dirty;
+
+    // The offset and the length are characters of the 2 x 56 character display.
+    void update(uint8_t offset, const char *text, uint8_t len);
+    void updateText(uint8_t strip, uint8_t row, const char *text);
+
+    // The next cells to send; returns the length of the message, 0 if nothing
+    // is pending.
+    uint8_t select(uint8_t &first, uint8_t &cells);
+
+    // Write the Display message of the selected cells and mark them as sent.
+    uint8_t read(uint8_t *buffer, uint8_t first, uint8_t cells);
+  };
+
+#if V2MACKIE_OUTPUT
+  // Output queue, sent from loop() with handleSend() in the order of the
+  // priority classes, limited by the bandwidth budget. A queued message
+  // is replaced by a later message to the same button, controller or
+  // channel. Lower classes are not starved completely.
+  enum class Priority {
+    Button,
+    Touch,
+    Fader,
+    VPot,
+    Meter,
+    Display,
+    _count,
+  };
+
+  struct OutputStatistics {
+    uint8_t pending[(uint8_t)Priority::_count];
+    uint32_t sent;
+    uint32_t coalesced;
+    uint32_t dropped;
+  };
+
+  // DIN MIDI: 3125 bytes per second. A rate of 0 disables the limit.
+  void setOutputBandwidth(uint16_t bytesPerSecond) {
+    _output.budget.rate = bytesPerSecond;
+  }
+
+  // Returns false if the message was dropped.
+  bool send(V2MIDI::Packet *packet);
+
+#if V2MACKIE_DISPLAY
+  // Update the display text; the changed cells are sent in small Display messages.
+  void sendDisplay(uint8_t offset, const char *text, uint8_t len) {
+    _output.display.update(offset, text, len);
+  }
+
+  void sendText(uint8_t strip, uint8_t row, const char *text) {
+    _output.display.updateText(strip, row, text);
+  }
+#endif
+
+  void getOutputStatistics(OutputStatistics &statistics);
+#endif
+
+  // The host link, measured with the ping messages of the host; TotalMix
+  // sends a ping every 800 milliseconds. The timeout follows the measured
+  // interval, it is 5 seconds until the interval is known. reset() restarts
+  // the measurement, the counters and the histogram are kept.
+  struct LinkStatistics {
+    bool active;
+
+    // Microseconds, the smoothed ping interval and its mean deviation.
+    uint32_t interval;
+    uint32_t jitter;
+    uint32_t timeout;
+
+    // Bucket n counts the deviations shorter than 2^n milliseconds, the last
+    // bucket all longer ones.
+    uint32_t histogram[8];
+
+    uint32_t pings;
+    uint32_t timeouts;
+
+    // The received messages in the last full second.
+    uint16_t rate;
+
+    // 0..1, the stability of the ping interval; 0 if the link is not active.
+    float quality;
+  };
+
+  void getLinkStatistics(LinkStatistics &statistics);
+
+  // HUI: convert a packet created by one of the set*() functions. HUI uses two
+  // messages for buttons and faders, the array needs to provide room for two
+  // packets. Returns the number of packets, 0 if HUI has no equivalent. VPot
+  // and jog rotations are not converted, their HUI encoding is not verified.
+  static uint8_t convertHUI(V2MIDI::Packet *packet, V2MIDI::Packet packets[2]);
+
+  // HUI: the reply to a host ping.
+  static V2MIDI::Packet *setHUIPing(V2MIDI::Packet *packet);
 
 protected:
+  // The clock of all timeouts and rates; it can be replaced to run the
+  // state machine with a simulated time.
+  virtual unsigned long getMicros() {
+    return micros();
+  }
+
   // Strips.
+#if V2MACKIE_VPOT
   virtual void handleStripVPotDisplay(uint8_t strip, VPotMode mode, bool center, float fraction){};
   virtual void handleStripVPotDisplay(uint8_t strip, uint8_t value){};
+#endif
   virtual void handleStripButton(uint8_t strip, StripButton button, bool on){};
   virtual void handleStripFader(uint8_t strip, float fraction){};
+#if V2MACKIE_METER
   virtual void handleStripMeter(uint8_t strip, float fraction, bool overload){};
   virtual void handleStripMeterOverload(uint8_t strip, bool overload){};
+#endif
 
+#if V2MACKIE_FRAMES
+  // The changes of all strips since the last frame, one StripChange bitmask per strip.
+  virtual void handleStripChanges(const uint8_t changes[8]){};
+#endif
+
+#if V2MACKIE_DISPLAY
   // Display strip updates chunked into individual strip messages.
   virtual void handleStripDisplay(bool global, uint8_t strip, uint8_t row){};
 
+  // The row switched between a global message and the individual strips.
+  virtual void handleDisplayGlobal(uint8_t row, bool global){};
+
+  // All changed cells of a Display message; bit 0..7 row 0, bit 8..15 row 1.
+  // It is called after the handleStripDisplay() calls of the message.
+  virtual void handleDisplay(uint16_t cells){};
+
+  // The changed strips of a row of a Display message, one bit per strip.
+  virtual void handleDisplayRow(bool global, uint8_t row, uint8_t strips){};
+#endif
+
   // Main volume fader.
   virtual void handleFader(float fraction){};
+  virtual void handleTouch(bool on){};
+
+  // Every button/LED state change, raised before the typed handler.
+  virtual void handleButton(uint8_t note, bool on){};
+
+  // The visible LEDs have changed, raised from loop() at most once per call;
+  // after LED messages and when the blink phase flips. It is raised in
+  // addition to the per-note handleButton() calls, unless setLEDFrames()
+  // replaces them; see getLEDs().
+  virtual void handleLEDs(const uint32_t leds[4]){};
 
   // Button press events.
+#if V2MACKIE_TRANSPORT
   virtual void handleTransportButton(TransportButton button, bool on){};
+#endif
   virtual void handleBankButton(BankButton button, bool on){};
   virtual void handleModifierButton(ModifierButton button, bool on){};
   virtual void handleNavigationButton(NavigationButton button, bool on){};
+  virtual void handleFunctionButton(uint8_t function, bool on){};
+  virtual void handleAutomationButton(AutomationButton button, bool on){};
+  virtual void handleUtilityButton(UtilityButton button, bool on){};
+  virtual void handleMarkerButton(MarkerButton button, bool on){};
+  virtual void handleUserSwitch(uint8_t index, bool on){};
 
+#if V2MACKIE_TIME
   // Time/Counter display update.
   virtual void handleTime(Time::Type type){};
+#endif
+
+#if V2MACKIE_OUTPUT
+  // Messages from the output queue.
+  virtual void handleSend(V2MIDI::Packet *packet){};
+  virtual void handleSendSystemExclusive(const uint8_t *buffer, uint32_t len){};
+#endif
+
+  // A ping from the host; HUI expects a reply, see setHUIPing().
+  virtual void handlePing(){};
 
   // If ping messages have been received, a timeout is raised after they stop.
   virtual void handleTimeout(){};
 
 private:
-  unsigned long _active_usec{};
+  // Defined by the library with its configuration; a mismatch fails to link.
+  void V2MACKIE_CONFIG();
+
+  struct Fader {
+    float position;
+
+    // A host position was received while the fader was touched.
+    bool resync;
+
+    // The last sent position, to detect the echo of the host.
+    float sent;
+    unsigned long usec;
+  };
+
+  Protocol _protocol{Protocol::Mackie};
 
   struct {
-    uint8_t strip[56 * 2];
-    uint8_t mode[2];
-    struct {
-      Time::Type type;
-      uint8_t digits[10];
-    } time;
+    // The last ping, 0 if the link is not active.
     unsigned long usec;
+    uint32_t interval;
+    uint32_t jitter;
+    uint32_t histogram[8];
+    uint32_t pings;
+    uint32_t timeouts;
+
+    struct {
+      unsigned long usec;
+      uint16_t count;
+      uint16_t last;
+    } rate;
+  } _link{};
+
+  // All buttons/LEDs, indexed by note number.
+  uint32_t _buttons[4]{};
+
+  struct {
+    // The subset of _buttons which blinks.
+    uint32_t blink[4];
+
+    // The last delivered LED frame.
+    uint32_t frame[4];
+    bool phase;
+    bool update;
+
+    // Do not raise the per-note handlers for LED messages.
+    bool frames;
+  } _leds{};
+
+#if V2MACKIE_DISPLAY
+  struct {
+    uint8_t strip[56 * 2];
+
+    // One bit per strip, the separator of the cell is not a space.
+    uint8_t separators[2];
   } _display{};
+#endif
+
+#if V2MACKIE_TIME
+  struct {
+    Time::Type type;
+    uint8_t digits[10];
+  } _time{};
+#endif
 
   struct {
-    char display[2][7];
+#if V2MACKIE_DISPLAY
+    Cell display[2];
+    uint8_t length[2];
+#endif
 
+#if V2MACKIE_VPOT
     struct {
       VPotMode mode;
       bool center;
       float value;
-      bool click;
+      uint8_t led;
     } vpot;
+#endif
 
-    struct {
-      float position;
-      bool touch;
-    } fader;
-
-    struct {
-      bool arm;
-      bool mute;
-      bool select;
-      bool solo;
-    } button;
+    Fader fader;
 
+#if V2MACKIE_METER
     struct {
       float fraction;
       bool overload;
       unsigned long usec;
     } meter;
+#endif
   } _strips[8]{};
 
   struct {
-    float fader;
+    Fader fader;
   } _main{};
 
+#if V2MACKIE_VPOT
+  // The accumulated steps of the 8 strip encoders and the jog wheel.
+  struct {
+    bool acceleration;
+    uint8_t next;
+    struct {
+      int16_t steps;
+      unsigned long usec;
+    } encoders[9];
+  } _rotation{};
+#endif
+
+#if V2MACKIE_OUTPUT
+  struct {
+    struct {
+      V2MIDI::Packet packets[8];
+
+      // Status byte and note or controller number.
+      uint16_t targets[8];
+      uint8_t count;
+
+      // The number of times a higher class was sent ahead.
+      uint8_t waiting;
+    } queues[(uint8_t)Priority::_count];
+
+#if V2MACKIE_DISPLAY
+    DisplayImage display;
+#endif
+
+    Budget budget;
+
+    uint32_t sent;
+    uint32_t coalesced;
+    uint32_t dropped;
+  } _output{};
+#endif
+
+#if V2MACKIE_EVENTS
   struct {
-    bool flip;
-    bool edit;
-  } _bank{};
+    bool enabled;
+    Event queue[32];
+    uint8_t head;
+    uint8_t count;
+    uint32_t lost;
+  } _events{};
+#endif
 
+#if V2MACKIE_FRAMES
   struct {
-    bool rewind;
-    bool forward;
-    bool stop;
-    bool play;
-    bool record;
-  } _transport{};
+    uint8_t fps;
+    uint8_t changes[8];
+    unsigned long usec;
+  } _frame{};
+#endif
 
+#if V2MACKIE_METER
   struct {
-    bool zoom;
-    bool scrub;
-  } _navigation{};
+    uint16_t tick;
+    bool decay;
+    uint8_t hold;
+    uint8_t timeout;
+    unsigned long usec;
+
+    // 4 bits per strip.
+    uint32_t levels;
+    uint32_t peaks;
+    uint32_t ages;
+    uint32_t holds;
+  } _meters{};
+#endif
 
+#if V2MACKIE_DISPLAY && V2MACKIE_SNAPSHOT
+  // Three pages: the writer fills the back page and publishes it as the
+  // latest one; the reader announces the page it takes. The writer continues
+  // with the page which is neither the latest nor announced by the reader.
+  struct {
+    Cell cells[3][16];
+
+    // The changed cells since the page the reader took before.
+    uint16_t changed[3];
+
+    // Owned by the writer.
+    uint8_t back{0};
+    uint16_t pending{};
+
+    // Bit 0..1: page, bit 2..31: serial; written only by the writer.
+    uint32_t latest{1};
+
+    // Bit 0..1: page, bit 2..31: serial of the taken page; written only by
+    // the reader.
+    uint32_t front{2};
+  } _pages{};
+#endif
+
+#if V2MACKIE_SNAPSHOT
+  struct {
+    uint32_t sequence;
+    uint8_t depth;
+    uint32_t retries;
+  } _snapshot{};
+#endif
+
+  struct {
+    // The zone of the following port message.
+    uint8_t zone;
+
+    // The fader MSB, waiting for the LSB.
+    uint8_t fader[8];
+  } _hui{};
+
+#if V2MACKIE_VPOT
+  void rotate(uint8_t index, int8_t steps);
+#endif
+#if V2MACKIE_PROFILE
+  Profile _profile{};
+  void addProfile(Handler handler, uint32_t usec);
+#endif
+
+#if V2MACKIE_TRACE
+  struct {
+    Trace::Record records[V2MACKIE_TRACE_SIZE];
+    uint16_t next;
+    uint16_t count;
+  } _trace{};
+
+  void addTrace(Trace::Type type, uint8_t index, uint16_t value);
+#endif
+
+#if V2MACKIE_PROFILE || V2MACKIE_TRACE
+  class HandlerScope {
+  public:
+    HandlerScope(V2Mackie *mackie, Handler handler) : _mackie(mackie), _handler(handler) {
+#if V2MACKIE_TRACE
+      _mackie->addTrace(Trace::Type::HandlerBegin, (uint8_t)handler, 0);
+#endif
+      _usec = _mackie->getMicros();
+    }
+
+    ~HandlerScope() {
+#if V2MACKIE_PROFILE
+      _mackie->addProfile(_handler, _mackie->getMicros() - _usec);
+#endif
+#if V2MACKIE_TRACE
+      _mackie->addTrace(Trace::Type::HandlerEnd, (uint8_t)_handler, 0);
+#endif
+    }
+
+  private:
+    V2Mackie *_mackie;
+    Handler _handler;
+    unsigned long _usec;
+  };
+#endif
+
+#if V2MACKIE_SNAPSHOT
+  void beginUpdate();
+  void endUpdate();
+#else
+  void beginUpdate() {}
+  void endUpdate() {}
+#endif
+  void dispatchMackiePacket(V2MIDI::Packet *packet);
+  void dispatchMackieSystemExclusive(const uint8_t *buffer, uint32_t len);
+  void updateLink();
+  void loopLink();
+  uint32_t getLinkTimeout();
+#if V2MACKIE_OUTPUT
+  void loopOutput();
+  bool isOutputPending(uint8_t index);
+  int8_t selectOutput();
+#endif
+  static uint8_t getStripButtonNote(StripButton button);
+  static void setCell(char cell[7], const char *text);
+  void setButtonState(uint8_t note, LED led);
+  void updateLEDs();
+  bool updateFader(Fader *fader, uint8_t touch, float fraction);
+  bool touchFader(Fader *fader, uint8_t touch, bool on);
+#if V2MACKIE_DISPLAY
+  void updateDisplay(uint8_t start, uint8_t len);
+#if V2MACKIE_SNAPSHOT
+  void flipDisplay(uint16_t cells);
+#else
+  void flipDisplay(uint16_t cells) {}
+#endif
+#endif
+#if V2MACKIE_EVENTS
+  bool pushEvent(Event::Type type, uint8_t index, uint16_t value);
+#else
+  bool pushEvent(Event::Type type, uint8_t index, uint16_t value) {
+    return false;
+  }
+#endif
+#if V2MACKIE_METER
+  void loopMeters();
+  void updateMeter(uint8_t strip, uint8_t level);
+#endif
+#if V2MACKIE_FRAMES
+  void loopFrame();
+  bool addStripChange(uint8_t strip, uint8_t change);
+#else
+  bool addStripChange(uint8_t strip, uint8_t change) {
+    return false;
+  }
+#endif
+  void notifyButton(uint8_t note, LED led);
+  void notifyStripFader(uint8_t strip);
+  void notifyFader();
+#if V2MACKIE_VPOT
+  void notifyStripVPot(uint8_t strip);
+#endif
+#if V2MACKIE_METER
+  void notifyStripMeter(uint8_t strip, bool overload);
+#endif
+#if V2MACKIE_DISPLAY
+  void notifyStripDisplay(bool global, uint8_t strip, uint8_t row);
+  void notifyDisplayGlobal(uint8_t row);
+  void notifyDisplay(const bool global[2], uint16_t cells);
+#endif
+#if V2MACKIE_TIME
+  void notifyTime();
+#endif
+  void notifyPing();
+  void notifyTimeout();
+  void notifyLEDs();
   void dispatchNote(uint8_t channel, uint8_t note, uint8_t velocity);
   void dispatchControlChange(uint8_t channel, uint8_t controller, uint8_t value);
+#if V2MACKIE_METER
   void dispatchAftertouchChannel(uint8_t channel, uint8_t pressure);
+#endif
   void dispatchPitchBend(uint8_t channel, int16_t value);
+  void dispatchHUIPacket(V2MIDI::Packet *packet);
+  void dispatchHUIControlChange(uint8_t controller, uint8_t value);
+  void dispatchHUISystemExclusive(const uint8_t *buffer, uint32_t len);
 };
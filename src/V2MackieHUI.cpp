@@ -0,0 +1,420 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2Mackie.h"
+#include "V2MackieProtocol.h"
+
+namespace HUI {
+// System Exclusive Messages.
+namespace Message {
+  // Header: vendor prefix, device type, 0, message type.
+  namespace Header {
+    enum {
+      Vendor,
+      Device = 3,
+      Type   = 5,
+      Message,
+    };
+  };
+
+  enum { Device = 5 };
+
+  namespace Type {
+    enum {
+      // zone, 4 characters
+      Display = 16,
+
+      // 8 digits, reverse order/right to left
+      Time = 17,
+
+      // zone, 10 characters; repeated
+      MainDisplay = 18,
+    };
+  };
+};
+
+namespace CC {
+  enum {
+    // 0-7, 7 bit MSB of the fader position.
+    FaderMSB = 0,
+
+    // Host -> Device: select the zone of the following LED Port message.
+    Zone = 12,
+
+    // Device -> Host: select the zone of the following switch Port message.
+    SwitchZone = 15,
+
+    // 32-39, 7 bit LSB of the fader position.
+    FaderLSB = 32,
+
+    // Bit 0..2: port, Bit 6: on
+    Port       = 44,
+    SwitchPort = 47,
+  };
+};
+
+// Host sends Note 0 / Velocity 0 every second, the device replies with Velocity 127.
+namespace Note {
+  enum { Ping = 0 };
+};
+
+// Meters are Polyphonic Aftertouch, note == strip, bit 0..3: level, bit 4: side.
+
+// The buttons and LEDs are addressed by zone (up to 30) and port (up to 8); the
+// table maps them to the Mackie note numbers, which share the state and handlers.
+enum { None = 0xff };
+static constexpr uint8_t Zones[][8]{
+  // 0..7: Channel Strips: fader touch, select, mute, solo, auto, v-sel, insert, rec/rdy.
+  {Mackie::ChannelStrip::Fader::Touch + 0,
+   Mackie::ChannelStrip::Button::Select + 0,
+   Mackie::ChannelStrip::Button::Mute + 0,
+   Mackie::ChannelStrip::Button::Solo + 0,
+   None,
+   Mackie::ChannelStrip::VPot::Push + 0,
+   None,
+   Mackie::ChannelStrip::Button::Arm + 0},
+  {Mackie::ChannelStrip::Fader::Touch + 1,
+   Mackie::ChannelStrip::Button::Select + 1,
+   Mackie::ChannelStrip::Button::Mute + 1,
+   Mackie::ChannelStrip::Button::Solo + 1,
+   None,
+   Mackie::ChannelStrip::VPot::Push + 1,
+   None,
+   Mackie::ChannelStrip::Button::Arm + 1},
+  {Mackie::ChannelStrip::Fader::Touch + 2,
+   Mackie::ChannelStrip::Button::Select + 2,
+   Mackie::ChannelStrip::Button::Mute + 2,
+   Mackie::ChannelStrip::Button::Solo + 2,
+   None,
+   Mackie::ChannelStrip::VPot::Push + 2,
+   None,
+   Mackie::ChannelStrip::Button::Arm + 2},
+  {Mackie::ChannelStrip::Fader::Touch + 3,
+   Mackie::ChannelStrip::Button::Select + 3,
+   Mackie::ChannelStrip::Button::Mute + 3,
+   Mackie::ChannelStrip::Button::Solo + 3,
+   None,
+   Mackie::ChannelStrip::VPot::Push + 3,
+   None,
+   Mackie::ChannelStrip::Button::Arm + 3},
+  {Mackie::ChannelStrip::Fader::Touch + 4,
+   Mackie::ChannelStrip::Button::Select + 4,
+   Mackie::ChannelStrip::Button::Mute + 4,
+   Mackie::ChannelStrip::Button::Solo + 4,
+   None,
+   Mackie::ChannelStrip::VPot::Push + 4,
+   None,
+   Mackie::ChannelStrip::Button::Arm + 4},
+  {Mackie::ChannelStrip::Fader::Touch + 5,
+   Mackie::ChannelStrip::Button::Select + 5,
+   Mackie::ChannelStrip::Button::Mute + 5,
+   Mackie::ChannelStrip::Button::Solo + 5,
+   None,
+   Mackie::ChannelStrip::VPot::Push + 5,
+   None,
+   Mackie::ChannelStrip::Button::Arm + 5},
+  {Mackie::ChannelStrip::Fader::Touch + 6,
+   Mackie::ChannelStrip::Button::Select + 6,
+   Mackie::ChannelStrip::Button::Mute + 6,
+   Mackie::ChannelStrip::Button::Solo + 6,
+   None,
+   Mackie::ChannelStrip::VPot::Push + 6,
+   None,
+   Mackie::ChannelStrip::Button::Arm + 6},
+  {Mackie::ChannelStrip::Fader::Touch + 7,
+   Mackie::ChannelStrip::Button::Select + 7,
+   Mackie::ChannelStrip::Button::Mute + 7,
+   Mackie::ChannelStrip::Button::Solo + 7,
+   None,
+   Mackie::ChannelStrip::VPot::Push + 7,
+   None,
+   Mackie::ChannelStrip::Button::Arm + 7},
+
+  // 8: Keyboard Shortcuts: ctrl, shift, edit mode, undo, alt, option, edit tool, save.
+  {Mackie::Modifier::Control,
+   Mackie::Modifier::Shift,
+   None,
+   Mackie::Utility::Undo,
+   Mackie::Modifier::Alt,
+   Mackie::Modifier::Option,
+   None,
+   None},
+
+  // 9: Window: mix, edit, transport, mem-loc, status, alt.
+  {Mackie::Utility::Mixer, None, None, Mackie::Utility::Marker, None, None, None, None},
+
+  // 10: Channel Selection: channel left, bank left, channel right, bank right.
+  {Mackie::Bank::PreviousChannel, Mackie::Bank::Previous, Mackie::Bank::NextChannel, Mackie::Bank::Next, None, None, None, None},
+
+  // 11: Assignment: output, input, pan, send e, send d, send c, send b, send a.
+  {None, None, Mackie::ChannelStrip::VPot::Pan, None, None, None, None, Mackie::ChannelStrip::VPot::Send},
+
+  // 12: Assignment: assign, default, suspend, shift, mute, bypass, rec/rdy all.
+  {None, None, None, None, None, None, None, None},
+
+  // 13: Cursor: down, left, mode, right, up, scrub, shuttle.
+  {Mackie::Navigation::Down,
+   Mackie::Navigation::Left,
+   Mackie::Navigation::Zoom,
+   Mackie::Navigation::Right,
+   Mackie::Navigation::Up,
+   Mackie::Navigation::Scrub,
+   None,
+   None},
+
+  // 14: Transport: talkback, rewind, fast forward, stop, play, record.
+  {None,
+   Mackie::Transport::Rewind,
+   Mackie::Transport::Forward,
+   Mackie::Transport::Stop,
+   Mackie::Transport::Play,
+   Mackie::Transport::Record,
+   None,
+   None},
+
+  // 15: Transport: return to zero, end, on line, loop, quick punch.
+  {Mackie::Marker::Home, Mackie::Marker::End, None, Mackie::Marker::Loop, None, None, None, None},
+
+  // 16: Transport: audition, pre, in, out, post.
+  {None, None, Mackie::Marker::PointIn, Mackie::Marker::PointOut, None, None, None, None},
+
+  // 17..19: Control Room, Numeric Keypad.
+  {None, None, None, None, None, None, None, None},
+  {None, None, None, None, None, None, None, None},
+  {None, None, None, None, None, None, None, None},
+
+  // 20: Auto Mode: trim, latch, read, off, write, touch.
+  {None, None, None, None, Mackie::Automation::Record, Mackie::Automation::Touch, None, None},
+
+  // 21..26: Status, Edit, Function Keys.
+  {None, None, None, None, None, None, None, None},
+  {None, None, None, None, None, None, None, None},
+  {None, None, None, None, None, None, None, None},
+  {None, None, None, None, None, None, None, None},
+  {None, None, None, None, None, None, None, None},
+  {None, None, None, None, None, None, None, None},
+
+  // 27: Function Keys: F1..F8.
+  {Mackie::Function::F1,
+   Mackie::Function::F2,
+   Mackie::Function::F3,
+   Mackie::Function::F4,
+   Mackie::Function::F5,
+   Mackie::Function::F6,
+   Mackie::Function::F7,
+   Mackie::Function::F8},
+};
+
+// The position of the 8 HH:MM:SS:FF digits in the 10 digits 3-2-2-3 Mackie time display.
+static constexpr uint8_t TimeDigits[8]{9, 8, 6, 5, 4, 3, 2, 1};
+};
+
+#if V2MACKIE_DISPLAY
+// The HUI character set matches ASCII for the printable characters, the
+// remaining ones are graphical symbols.
+static char getCharacter(uint8_t c) {
+  if (c < 0x20 || c > 0x7e)
+    return ' ';
+
+  return c;
+}
+#endif
+
+static bool getZonePort(uint8_t note, uint8_t &zone, uint8_t &port) {
+  for (uint8_t z = 0; z < sizeof(HUI::Zones) / sizeof(HUI::Zones[0]); z++) {
+    for (uint8_t p = 0; p < 8; p++) {
+      if (HUI::Zones[z][p] != note)
+        continue;
+
+      zone = z;
+      port = p;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+V2MIDI::Packet *V2Mackie::setHUIPing(V2MIDI::Packet *packet) {
+  return packet->setNote(0, HUI::Note::Ping, 127);
+}
+
+uint8_t V2Mackie::convertHUI(V2MIDI::Packet *packet, V2MIDI::Packet packets[2]) {
+  switch (packet->getType()) {
+    case V2MIDI::Packet::Status::NoteOn:
+    case V2MIDI::Packet::Status::NoteOff: {
+      if (packet->getChannel() != 0)
+        return 0;
+
+      uint8_t zone;
+      uint8_t port;
+      if (!getZonePort(packet->getNote(), zone, port))
+        return 0;
+
+      bool on = packet->getType() == V2MIDI::Packet::Status::NoteOn && packet->getNoteVelocity() > 0;
+      packets[0].setControlChange(0, HUI::CC::SwitchZone, zone);
+      packets[1].setControlChange(0, HUI::CC::SwitchPort, port | (on ? 0x40 : 0));
+      return 2;
+    }
+
+    case V2MIDI::Packet::Status::PitchBend: {
+      // HUI has no main fader.
+      const uint8_t strip = packet->getChannel();
+      if (strip > 7)
+        return 0;
+
+      const uint16_t value = packet->getPitchBend() + 8192;
+      packets[0].setControlChange(0, HUI::CC::FaderMSB + strip, value >> 7);
+      packets[1].setControlChange(0, HUI::CC::FaderLSB + strip, value & 0x7f);
+      return 2;
+    }
+
+    default:
+      return 0;
+  }
+}
+
+void V2Mackie::dispatchHUIControlChange(uint8_t controller, uint8_t value) {
+  switch (controller) {
+    case HUI::CC::FaderMSB... HUI::CC::FaderMSB + 7:
+      _hui.fader[controller - HUI::CC::FaderMSB] = value;
+      break;
+
+    case HUI::CC::FaderLSB... HUI::CC::FaderLSB + 7: {
+      const uint8_t strip = controller - HUI::CC::FaderLSB;
+      dispatchPitchBend(strip, (int16_t)(_hui.fader[strip] << 7 | value) - 8192);
+    } break;
+
+    case HUI::CC::Zone:
+      _hui.zone = value;
+      break;
+
+    case HUI::CC::Port: {
+      if (_hui.zone >= sizeof(HUI::Zones) / sizeof(HUI::Zones[0]))
+        break;
+
+      const uint8_t note = HUI::Zones[_hui.zone][value & 7];
+      if (note == HUI::None)
+        break;
+
+      dispatchNote(0, note, (value & 0x40) ? 127 : 0);
+    } break;
+
+    case V2MIDI::CC::AllSoundOff:
+    case V2MIDI::CC::AllNotesOff:
+      reset();
+      break;
+  }
+}
+
+void V2Mackie::dispatchHUIPacket(V2MIDI::Packet *packet) {
+  if (packet->getChannel() != 0)
+    return;
+
+  switch (packet->getType()) {
+    case V2MIDI::Packet::Status::NoteOn:
+    case V2MIDI::Packet::Status::NoteOff:
+      if (packet->getNote() != HUI::Note::Ping)
+        break;
+
+      updateLink();
+      notifyPing();
+      break;
+
+    case V2MIDI::Packet::Status::ControlChange:
+      dispatchHUIControlChange(packet->getController(), packet->getControllerValue());
+      break;
+
+#if V2MACKIE_METER
+    case V2MIDI::Packet::Status::Aftertouch: {
+      // The strip state has a single meter, use the left side.
+      const uint8_t strip = packet->getAftertouchNote();
+      const uint8_t value = packet->getAftertouch();
+      if (strip > 7 || (value & 0x10))
+        break;
+
+      const uint8_t level = value & 0x0f;
+      dispatchAftertouchChannel(0, strip << 4 | (level > 12 ? 12 : level));
+    } break;
+#endif
+
+    default:
+      break;
+  }
+}
+
+void V2Mackie::dispatchHUISystemExclusive(const uint8_t *buffer, uint32_t len) {
+  if (len < 1 + HUI::Message::Header::Message + 1)
+    return;
+
+  // Remove SysEx start and end byte.
+  const uint8_t *p = buffer + 1;
+  uint32_t l       = len - 2;
+
+  if (memcmp(p + HUI::Message::Header::Vendor, Mackie::Message::Vendor, sizeof(Mackie::Message::Vendor)) != 0)
+    return;
+
+  if (p[HUI::Message::Header::Device] != HUI::Message::Device)
+    return;
+
+  const uint8_t type = p[HUI::Message::Header::Type];
+  p += HUI::Message::Header::Message;
+  l -= HUI::Message::Header::Message;
+
+  switch (type) {
+#if V2MACKIE_DISPLAY
+    case HUI::Message::Type::Display: {
+      // F0 00 00 66 05 00 10 00 41 75 64 31 F7           |   f    Aud1|
+      if (l < 1 + 4)
+        return;
+
+      const uint8_t zone = p[0];
+      if (zone > 7)
+        return;
+
+      // The 4 character strip names become row 1 of the strip.
+      char *text = (char *)_display.strip + (7 * zone);
+      for (uint8_t i = 0; i < 4; i++)
+        text[i] = getCharacter(p[1 + i]);
+      memset(text + 4, ' ', 3);
+
+      updateDisplay(7 * zone, 7);
+    } break;
+
+    case HUI::Message::Type::MainDisplay: {
+      // The 2 x 40 character display, zone 0..3 is the upper, 4..7 the lower
+      // line, 10 characters each. The strip model has room for one line, the
+      // lower line carries the parameter values; it becomes row 2.
+      uint8_t first = 0xff;
+      uint8_t last  = 0;
+      for (; l >= 1 + 10; p += 1 + 10, l -= 1 + 10) {
+        const uint8_t zone = p[0];
+        if (zone < 4 || zone > 7)
+          continue;
+
+        const uint8_t start = 56 + ((zone - 4) * 10);
+        for (uint8_t i = 0; i < 10; i++)
+          _display.strip[start + i] = getCharacter(p[1 + i]);
+
+        if (start < first)
+          first = start;
+        if (start + 10 > last)
+          last = start + 10;
+      }
+
+      if (first < last)
+        updateDisplay(first, last - first);
+    } break;
+#endif
+
+#if V2MACKIE_TIME
+    case HUI::Message::Type::Time: {
+      // Bit 0..3: digit, Bit 4: dot.
+      for (uint8_t i = 0; i < l && i < 8; i++)
+        _time.digits[HUI::TimeDigits[i]] = '0' + (p[i] & 0x0f);
+
+      notifyTime();
+    } break;
+#endif
+  }
+}
@@ -0,0 +1,91 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2Mackie.h"
+
+// A ping from the host.
+void V2Mackie::updateLink() {
+  const unsigned long usec = getMicros();
+
+  // The first ping after a timeout starts a new measurement.
+  if (_link.usec > 0) {
+    const uint32_t interval = usec - _link.usec;
+
+    if (_link.interval == 0) {
+      _link.interval = interval;
+
+    } else {
+      const uint32_t deviation = interval > _link.interval ? interval - _link.interval : _link.interval - interval;
+
+      uint8_t bucket = 0;
+      while (bucket < 7 && deviation >= (1000UL << bucket))
+        bucket++;
+      _link.histogram[bucket]++;
+
+      // Exponential moving averages.
+      _link.interval = (int32_t)_link.interval + ((int32_t)interval - (int32_t)_link.interval) / 8;
+      _link.jitter   = (int32_t)_link.jitter + ((int32_t)deviation - (int32_t)_link.jitter) / 8;
+    }
+  }
+
+  _link.usec = usec == 0 ? 1 : usec;
+  _link.pings++;
+}
+
+uint32_t V2Mackie::getLinkTimeout() {
+  if (_link.interval == 0)
+    return 5000UL * 1000;
+
+  // Allow a late ping, but not a missing one.
+  uint32_t timeout = _link.interval + (_link.interval / 2) + (4 * _link.jitter);
+  if (timeout < 250UL * 1000)
+    timeout = 250UL * 1000;
+
+  if (timeout > 5000UL * 1000)
+    timeout = 5000UL * 1000;
+
+  return timeout;
+}
+
+void V2Mackie::loopLink() {
+  if ((unsigned long)(getMicros() - _link.rate.usec) >= 1000UL * 1000) {
+    _link.rate.usec  = getMicros();
+    _link.rate.last  = _link.rate.count;
+    _link.rate.count = 0;
+  }
+
+  if (_link.usec == 0)
+    return;
+
+  if ((unsigned long)(getMicros() - _link.usec) <= getLinkTimeout())
+    return;
+
+  _link.usec     = 0;
+  _link.interval = 0;
+  _link.jitter   = 0;
+  _link.timeouts++;
+  V2MACKIE_TRACE_EVENT(Timeout, 0, 0);
+  notifyTimeout();
+}
+
+void V2Mackie::getLinkStatistics(LinkStatistics &statistics) {
+  statistics.active   = _link.usec > 0;
+  statistics.interval = _link.interval;
+  statistics.jitter   = _link.jitter;
+  statistics.timeout  = getLinkTimeout();
+  memcpy(statistics.histogram, _link.histogram, sizeof(statistics.histogram));
+  statistics.pings    = _link.pings;
+  statistics.timeouts = _link.timeouts;
+  statistics.rate     = _link.rate.last;
+
+  statistics.quality = 0;
+  if (_link.usec > 0) {
+    if (_link.interval == 0) {
+      statistics.quality = 1;
+
+    } else {
+      const float deviation = 4.f * (float)_link.jitter / (float)_link.interval;
+      statistics.quality    = deviation < 1.f ? 1.f - deviation : 0;
+    }
+  }
+}
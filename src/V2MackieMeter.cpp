@@ -0,0 +1,145 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2Mackie.h"
+
+#if V2MACKIE_METER
+// The meters of all strips are processed at once, every strip is a 4-bit
+// lane of a 32-bit word.
+static constexpr uint32_t Lanes = 0x11111111;
+
+static uint32_t getLanes(uint8_t value) {
+  return value * Lanes;
+}
+
+// The lowest bit of every lane which is not zero.
+static uint32_t getNonZero(uint32_t x) {
+  return (x | x >> 1 | x >> 2 | x >> 3) & Lanes;
+}
+
+static uint32_t decrement(uint32_t x) {
+  return x - getNonZero(x);
+}
+
+// Saturates at 15.
+static uint32_t increment(uint32_t x) {
+  return x + getNonZero(~x);
+}
+
+// All bits of every lane where a >= b. The even and the odd lanes are
+// compared separately in 8-bit slots; the guard bit above the lane
+// survives the subtraction if there is no borrow.
+static uint32_t getGreaterEqual(uint32_t a, uint32_t b) {
+  const uint32_t even = ((a & 0x0f0f0f0f) | 0x10101010) - (b & 0x0f0f0f0f);
+  const uint32_t odd  = (((a >> 4) & 0x0f0f0f0f) | 0x10101010) - ((b >> 4) & 0x0f0f0f0f);
+  return (((even & 0x10101010) >> 4) | (odd & 0x10101010)) * 0xf;
+}
+
+static uint32_t getMax(uint32_t a, uint32_t b) {
+  const uint32_t ge = getGreaterEqual(a, b);
+  return (a & ge) | (b & ~ge);
+}
+
+void V2Mackie::setMeterProcessing(uint16_t tickMsec, bool decay, uint8_t hold, uint8_t timeout) {
+  // The peaks are released with the ticks.
+  if (tickMsec == 0)
+    hold = 0;
+
+  _meters.tick    = tickMsec;
+  _meters.decay   = decay;
+  _meters.hold    = hold > 15 ? 15 : hold;
+  _meters.timeout = timeout > 15 ? 15 : timeout;
+  _meters.usec    = getMicros();
+
+  _meters.levels = 0;
+  _meters.peaks  = 0;
+  _meters.ages   = 0;
+  _meters.holds  = 0;
+  for (uint8_t i = 0; i < 8; i++)
+    updateMeter(i, (uint8_t)(_strips[i].meter.fraction * 12.f));
+}
+
+void V2Mackie::updateMeter(uint8_t strip, uint8_t level) {
+  const uint8_t shift = strip * 4;
+  const uint32_t mask = 0xfUL << shift;
+
+  _meters.levels = (_meters.levels & ~mask) | ((uint32_t)level << shift);
+
+  // A new peak restarts the hold time.
+  if (level >= ((_meters.peaks >> shift) & 0xf)) {
+    _meters.peaks = (_meters.peaks & ~mask) | ((uint32_t)level << shift);
+    _meters.holds &= ~mask;
+  }
+}
+
+void V2Mackie::loopMeters() {
+  if (_meters.tick == 0) {
+    for (uint8_t i = 0; i < 8; i++) {
+      if (_strips[i].meter.fraction <= 0.f)
+        continue;
+
+      if ((unsigned long)(getMicros() - _strips[i].meter.usec) < 1000 * 1000)
+        continue;
+
+      const uint32_t mask = 0xfUL << (i * 4);
+      _meters.levels &= ~mask;
+      _meters.peaks &= ~mask;
+
+      _strips[i].meter = {};
+      V2MACKIE_TRACE_EVENT(MeterTimeout, i, 0);
+      notifyStripMeter(i, false);
+    }
+
+    return;
+  }
+
+  if ((unsigned long)(getMicros() - _meters.usec) < (unsigned long)_meters.tick * 1000)
+    return;
+
+  _meters.usec += (unsigned long)_meters.tick * 1000;
+
+  const uint32_t levels = _meters.levels;
+  const uint32_t peaks  = _meters.peaks;
+
+  _meters.ages  = increment(_meters.ages);
+  _meters.holds = increment(_meters.holds);
+
+  uint32_t expired = 0;
+  if (_meters.timeout > 0)
+    expired = getGreaterEqual(_meters.ages, getLanes(_meters.timeout));
+
+  _meters.levels &= ~expired;
+  if (_meters.decay)
+    _meters.levels = decrement(_meters.levels);
+
+  // The released peaks fall by one step, but not below the level.
+  const uint32_t released = getGreaterEqual(_meters.holds, getLanes(_meters.hold));
+  _meters.peaks           = (_meters.peaks & ~(released | expired)) | (decrement(_meters.peaks) & released & ~expired);
+  _meters.peaks           = getMax(_meters.peaks, _meters.levels);
+
+  uint32_t changed = getNonZero(levels ^ _meters.levels);
+  if (_meters.hold > 0)
+    changed |= getNonZero(peaks ^ _meters.peaks);
+
+  // The overload indicator is cleared with the timeout.
+  for (uint8_t i = 0; i < 8; i++) {
+    if (_strips[i].meter.overload && (expired & (1UL << (i * 4))))
+      changed |= 1UL << (i * 4);
+  }
+
+  while (changed != 0) {
+    const uint8_t strip = __builtin_ctzl(changed) / 4;
+    changed &= changed - 1;
+
+    bool overload = false;
+    if (expired & (1UL << (strip * 4))) {
+      V2MACKIE_TRACE_EVENT(MeterTimeout, strip, 0);
+      overload                      = _strips[strip].meter.overload;
+      _strips[strip].meter.overload = false;
+    }
+
+    _strips[strip].meter.fraction = (float)((_meters.levels >> (strip * 4)) & 0xf) / 12.f;
+    notifyStripMeter(strip, overload);
+  }
+}
+#endif
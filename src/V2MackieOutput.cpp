@@ -0,0 +1,350 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2Mackie.h"
+#include "V2MackieProtocol.h"
+
+bool V2Mackie::Budget::take(uint8_t n, unsigned long now) {
+  if (rate == 0)
+    return true;
+
+  // Allow a burst of a few messages.
+  const uint8_t max = 32;
+
+  const unsigned long elapsed = now - usec;
+  const uint32_t available    = (uint64_t)elapsed * rate / (1000 * 1000);
+  if (bytes + available >= max) {
+    bytes = max;
+    usec  = now;
+
+  } else if (available > 0) {
+    // Keep the remainder of the elapsed time.
+    bytes += available;
+    usec += available * 1000 * 1000 / rate;
+  }
+
+  if (n > bytes)
+    return false;
+
+  bytes -= n;
+  return true;
+}
+
+#if V2MACKIE_OUTPUT
+static V2Mackie::Priority getPriority(const uint8_t *message) {
+  switch (message[0] & 0xf0) {
+    case 0x80:
+    case 0x90:
+      switch (message[1]) {
+        case Mackie::ChannelStrip::Fader::Touch... Mackie::ChannelStrip::Fader::Touch + 7:
+        case Mackie::Main::Touch:
+          return V2Mackie::Priority::Touch;
+      }
+      return V2Mackie::Priority::Button;
+
+    case 0xb0:
+      switch (message[1]) {
+        case Mackie::ChannelStrip::VPot::Encoder... Mackie::ChannelStrip::VPot::Encoder + 7:
+        case Mackie::ChannelStrip::VPot::LED... Mackie::ChannelStrip::VPot::LED + 7:
+        case Mackie::Navigation::Jog:
+          return V2Mackie::Priority::VPot;
+
+        case Mackie::Display::Time::Digit... Mackie::Display::Mode::Digit + 1:
+          return V2Mackie::Priority::Display;
+      }
+      return V2Mackie::Priority::Button;
+
+    case 0xe0:
+      return V2Mackie::Priority::Fader;
+
+    case 0xa0:
+    case 0xd0:
+      return V2Mackie::Priority::Meter;
+
+    default:
+      return V2Mackie::Priority::Button;
+  }
+}
+#endif
+
+uint16_t V2Mackie::getMessageTarget(const uint8_t message[3]) {
+  uint8_t status = message[0];
+
+  // Note Off and Note On address the same note.
+  if ((status & 0xf0) == 0x80)
+    status |= 0x10;
+
+  switch (status & 0xf0) {
+    case 0x90:
+    case 0xa0:
+    case 0xb0:
+      return status << 8 | message[1];
+
+    case 0xd0:
+      // The strip index; the overload flag is a separate target.
+      return status << 8 | (message[1] >> 4) | ((message[1] & 0x0f) >= 14 ? 0x80 : 0);
+
+    default:
+      return status << 8;
+  }
+}
+
+int8_t V2Mackie::getMessageFader(const uint8_t message[3]) {
+  switch (message[0] & 0xf0) {
+    case 0x80:
+    case 0x90:
+      if (message[0] & 0x0f)
+        return -1;
+
+      switch (message[1]) {
+        case Mackie::ChannelStrip::Fader::Touch... Mackie::ChannelStrip::Fader::Touch + 7:
+          return message[1] - Mackie::ChannelStrip::Fader::Touch;
+
+        case Mackie::Main::Touch:
+          return 8;
+      }
+      return -1;
+
+    case 0xe0:
+      if ((message[0] & 0x0f) > 8)
+        return -1;
+
+      return message[0] & 0x0f;
+
+    default:
+      return -1;
+  }
+}
+
+void V2Mackie::DisplayImage::update(uint8_t offset, const char *text, uint8_t len) {
+  if (offset + len > sizeof(this->text))
+    return;
+
+  for (uint8_t i = 0; i < len; i++) {
+    if (this->text[offset + i] == text[i])
+      continue;
+
+    this->text[offset + i] = text[i];
+    dirty |= 1 << ((offset + i) / 7);
+  }
+}
+
+void V2Mackie::DisplayImage::updateText(uint8_t strip, uint8_t row, const char *text) {
+  char cell[7];
+  setCell(cell, text);
+  update((56 * row) + (7 * strip), cell, 7);
+}
+
+uint8_t V2Mackie::DisplayImage::select(uint8_t &first, uint8_t &cells) {
+  first = 0;
+  cells = 0;
+  if (dirty == 0)
+    return 0;
+
+  while (!(dirty & (1 << first)))
+    first++;
+
+  cells = 1;
+  if (first < 15 && (dirty & (1 << (first + 1))))
+    cells = 2;
+
+  return 1 + sizeof(Mackie::Message::Vendor) + 3 + (cells * 7) + 1;
+}
+
+static_assert(V2Mackie::DisplayImage::MessageSize == 1 + sizeof(Mackie::Message::Vendor) + 3 + (2 * 7) + 1,
+              "Display message size");
+
+uint8_t V2Mackie::DisplayImage::read(uint8_t *buffer, uint8_t first, uint8_t cells) {
+  dirty &= ~(((1 << cells) - 1) << first);
+  return setDisplay(buffer, first * 7, text + (first * 7), cells * 7);
+}
+
+#if V2MACKIE_OUTPUT
+static int8_t getRotationSteps(uint8_t value) {
+  // Bit 0..5: steps, Bit 6: counter clockwise.
+  if (value & 0x40)
+    return -(value & 0x3f);
+
+  return value & 0x3f;
+}
+
+bool V2Mackie::send(V2MIDI::Packet *packet) {
+  uint8_t message[3];
+  if (getMessage(packet, message) == 0)
+    return false;
+
+  const Priority priority = getPriority(message);
+  const uint16_t target   = getMessageTarget(message);
+  auto *queue             = &_output.queues[(uint8_t)priority];
+
+  switch (priority) {
+    // Every button press and release is sent.
+    case Priority::Button:
+    case Priority::Touch:
+      break;
+
+    default:
+      for (uint8_t i = 0; i < queue->count; i++) {
+        if (queue->targets[i] != target)
+          continue;
+
+        switch (message[1]) {
+          case Mackie::ChannelStrip::VPot::Encoder... Mackie::ChannelStrip::VPot::Encoder + 7:
+          case Mackie::Navigation::Jog:
+            if ((message[0] & 0xf0) == 0xb0) {
+              // Relative rotations are added up.
+              const int16_t steps =
+                getRotationSteps(queue->packets[i].getControllerValue()) + getRotationSteps(message[2]);
+              if (steps < -63 || steps > 63)
+                continue;
+
+              if (message[1] == Mackie::Navigation::Jog)
+                setJog(&queue->packets[i], steps);
+
+              else
+                setStripVPot(&queue->packets[i], message[1] - Mackie::ChannelStrip::VPot::Encoder, steps);
+
+              _output.coalesced++;
+              return true;
+            }
+            break;
+        }
+
+        queue->packets[i] = *packet;
+        _output.coalesced++;
+        return true;
+      }
+      break;
+  }
+
+  if (queue->count == sizeof(queue->packets) / sizeof(queue->packets[0])) {
+    _output.dropped++;
+    return false;
+  }
+
+  queue->packets[queue->count] = *packet;
+  queue->targets[queue->count] = target;
+  queue->count++;
+  return true;
+}
+
+void V2Mackie::getOutputStatistics(OutputStatistics &statistics) {
+  for (uint8_t i = 0; i < (uint8_t)Priority::_count; i++)
+    statistics.pending[i] = _output.queues[i].count;
+
+  statistics.sent      = _output.sent;
+  statistics.coalesced = _output.coalesced;
+  statistics.dropped   = _output.dropped;
+}
+
+bool V2Mackie::isOutputPending(uint8_t index) {
+  if (_output.queues[index].count > 0)
+    return true;
+
+#if V2MACKIE_DISPLAY
+  if (index == (uint8_t)Priority::Display && _output.display.dirty != 0)
+    return true;
+#endif
+
+  return false;
+}
+
+// The class to send next, -1 if nothing is pending.
+int8_t V2Mackie::selectOutput() {
+  int8_t selected = -1;
+
+  for (uint8_t i = 0; i < (uint8_t)Priority::_count; i++) {
+    if (!isOutputPending(i))
+      continue;
+
+    if (selected < 0) {
+      selected = i;
+      continue;
+    }
+
+    // A lower class which was passed over too often.
+    if (_output.queues[i].waiting >= 16)
+      return i;
+  }
+
+  return selected;
+}
+
+void V2Mackie::loopOutput() {
+  for (;;) {
+    const int8_t index = selectOutput();
+    if (index < 0)
+      return;
+
+    auto *queue  = &_output.queues[index];
+    uint8_t next = 0;
+
+    // The class of the sent message.
+    uint8_t sent = index;
+    if (queue->count > 0) {
+      uint8_t message[3];
+      uint8_t len = getMessage(&queue->packets[0], message);
+
+      // A touch release is sent after the last position of its fader.
+      if (index == (uint8_t)Priority::Touch && ((message[0] & 0xf0) == 0x80 || message[2] == 0)) {
+        const int8_t fader = getMessageFader(message);
+        auto *faders       = &_output.queues[(uint8_t)Priority::Fader];
+        for (uint8_t i = 0; i < faders->count; i++) {
+          uint8_t position[3];
+          const uint8_t n = getMessage(&faders->packets[i], position);
+          if (getMessageFader(position) != fader)
+            continue;
+
+          queue = faders;
+          next  = i;
+          len   = n;
+          sent  = (uint8_t)Priority::Fader;
+          break;
+        }
+      }
+
+      if (!_output.budget.take(len, getMicros()))
+        return;
+
+      V2MIDI::Packet packet = queue->packets[next];
+      queue->count--;
+      memmove(&queue->packets[next], &queue->packets[next + 1], (queue->count - next) * sizeof(queue->packets[0]));
+      memmove(&queue->targets[next], &queue->targets[next + 1], (queue->count - next) * sizeof(queue->targets[0]));
+
+      V2MACKIE_HANDLER(Send);
+      handleSend(&packet);
+
+#if V2MACKIE_DISPLAY
+    } else {
+      uint8_t first;
+      uint8_t cells;
+      const uint8_t len = _output.display.select(first, cells);
+      if (!_output.budget.take(len, getMicros()))
+        return;
+
+      uint8_t buffer[DisplayImage::MessageSize];
+      _output.display.read(buffer, first, cells);
+
+      V2MACKIE_HANDLER(Send);
+      handleSendSystemExclusive(buffer, len);
+#endif
+    }
+
+    _output.sent++;
+
+    // Count the waiting time of the other pending classes.
+    for (uint8_t i = 0; i < (uint8_t)Priority::_count; i++) {
+      if (i == sent) {
+        _output.queues[i].waiting = 0;
+        continue;
+      }
+
+      if (!isOutputPending(i))
+        continue;
+
+      if (_output.queues[i].waiting < 255)
+        _output.queues[i].waiting++;
+    }
+  }
+}
+#endif
@@ -0,0 +1,93 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2Mackie.h"
+
+#if V2MACKIE_PROFILE
+#include <stdarg.h>
+#include <stdio.h>
+
+void V2Mackie::addProfile(Handler handler, uint32_t usec) {
+  auto *h = &_profile.handlers[(uint8_t)handler];
+
+  if (h->count == 0 || usec < h->min)
+    h->min = usec;
+
+  if (usec > h->max)
+    h->max = usec;
+
+  h->count++;
+  h->total += usec;
+
+  const uint8_t buckets = sizeof(h->histogram) / sizeof(h->histogram[0]);
+  uint8_t bucket        = usec == 0 ? 0 : 32 - __builtin_clz(usec);
+  if (bucket > buckets - 1)
+    bucket = buckets - 1;
+
+  h->histogram[bucket]++;
+}
+
+// Append to the text, it is truncated if it does not fit.
+static void print(char *text, uint32_t size, uint32_t &len, const char *format, ...) {
+  if (len + 1 >= size)
+    return;
+
+  va_list args;
+  va_start(args, format);
+  const int n = vsnprintf(text + len, size - len, format, args);
+  va_end(args);
+
+  if (n < 0)
+    return;
+
+  len += (uint32_t)n < size - len ? n : size - len - 1;
+}
+
+uint32_t V2Mackie::printProfile(char *text, uint32_t size) {
+  static const char *const names[]{
+    "Button",
+    "StripFader",
+    "Fader",
+    "StripVPot",
+    "StripMeter",
+    "StripDisplay",
+    "DisplayGlobal",
+    "Display",
+    "StripChanges",
+    "Time",
+    "LEDs",
+    "Ping",
+    "Timeout",
+    "Send",
+  };
+  static_assert(sizeof(names) / sizeof(names[0]) == (uint8_t)Handler::_count);
+
+  if (size == 0)
+    return 0;
+
+  uint32_t len = 0;
+  text[0]      = '\0';
+  for (uint8_t i = 0; i < (uint8_t)Handler::_count; i++) {
+    const auto *h = &_profile.handlers[i];
+    if (h->count == 0)
+      continue;
+
+    print(text,
+          size,
+          len,
+          "%-13s %8lu %6lu %6lu %6lu |",
+          names[i],
+          (unsigned long)h->count,
+          (unsigned long)h->min,
+          (unsigned long)(h->total / h->count),
+          (unsigned long)h->max);
+
+    for (uint8_t b = 0; b < sizeof(h->histogram) / sizeof(h->histogram[0]); b++)
+      print(text, size, len, " %lu", (unsigned long)h->histogram[b]);
+
+    print(text, size, len, "\n");
+  }
+
+  return len;
+}
+#endif
@@ -0,0 +1,281 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+// Mackie Control protocol constants, shared by the protocol engines.
+#pragma once
+
+#include <stdint.h>
+
+namespace Mackie {
+// System Exclusive Messages.
+namespace Message {
+  // Header:  vendor prefix, device type, message type.
+  namespace Header {
+    enum {
+      Vendor,
+      Device = 3,
+      Type,
+      Message,
+    };
+  };
+
+  // 3 bytes MIDI vendor ID.
+  static constexpr uint8_t Vendor[3]{0x00, 0x00, 0x66};
+
+  namespace Device {
+    enum {
+      Control   = 20,
+      ControlXT = 21,
+    };
+  };
+
+  namespace Type {
+    enum {
+      TranportButtonClick = 10,
+
+      // 0..127 minutes
+      BacklightTimout = 11,
+
+      TouchlessFader = 12,
+
+      // strip, 0..5
+      TouchSensitivity = 14,
+
+      TimeDisplay = 16,
+
+      ModeDisplay = 17,
+
+      // offset, characters
+      Display = 18,
+
+      Version      = 19,
+      VersionReply = 20,
+
+      // strip, mode
+      MeterMode = 32,
+
+      // 0 = horizontal / 1 = vertical
+      MeterOrientation = 33,
+
+      FaderHome = 97,
+      LEDsOff   = 98,
+      Reset     = 99
+    };
+  };
+
+  // 1 byte index, up to 56 * 2 bytes text.
+  namespace Display::Header {
+    enum {
+      Index,
+      Text,
+    };
+  };
+};
+
+namespace Display {
+  // 56 character, 2 row LCD display.
+  // 8 channel strips * 7 characters == 56.
+  namespace Strip {
+    enum Note { NameValue = 52 };
+  };
+
+  // 10 digits, 3-2-2-3 grouping.
+  namespace Time {
+    enum CC {
+      // 64-73, reverse order/right to left.
+      Digit = 64
+    };
+
+    // Switch between Hours-Minutes-Seconds-Frames and Bars-Beats-SubDivision-Ticks mode.
+    enum Note { SMPTEBeats = 53 };
+  };
+
+  // 2 digits.
+  namespace Mode {
+    enum CC {
+      // 74-57, reverse order/right to left.
+      Digit = 74
+    };
+  };
+};
+
+namespace ChannelStrip {
+  // Push and rotary control.
+  namespace VPot {
+    enum Mode {
+      Single,
+      Boost,
+      Bar,
+      Spread,
+    };
+
+    enum CC {
+      // Bit 0..5: steps
+      // Bit 6:    0 == clockwise, 1 == counter clockwise
+      Encoder = 16,
+
+      // Bit 0..3: value
+      // Bit 4..5: mode
+      // Bit 6:    center dot
+      LED = 48,
+    };
+
+    enum Note {
+      Push       = 32,
+      Track      = 40,
+      Send       = 41,
+      Pan        = 42,
+      PlugIn     = 43,
+      Equalizer  = 44,
+      Instrument = 45,
+    };
+  };
+
+  // Buttons and fader touch.
+  namespace Button {
+    enum Note {
+      Arm    = 0,
+      Solo   = 8,
+      Mute   = 16,
+      Select = 24,
+    };
+  };
+
+  // The fader controls pitch bend channel 1-8.
+  namespace Fader {
+    enum Note {
+      Touch = 104,
+    };
+  };
+
+  // The meter is Channel Aftertouch 4 bit index + value 0..12 + overload flag.
+};
+
+// The main fader.
+namespace Main {
+  enum Note {
+    // Value 0/127.
+    Touch = 112
+  };
+
+  // The main fader controls pitch bend channel 9
+};
+
+namespace Bank {
+  enum Note {
+    // Move 8/16/32 channel strips. Up to three extension units, each adds 8
+    // channel strips to a bank.
+    Previous = 46,
+    Next     = 47,
+
+    // Move a single channel.
+    PreviousChannel = 48,
+    NextChannel     = 49,
+
+    Flip = 50,
+    Edit = 51,
+  };
+};
+
+namespace Function {
+  enum Note {
+    F1  = 54,
+    F2  = 55,
+    F3  = 56,
+    F4  = 57,
+    F5  = 58,
+    F6  = 59,
+    F7  = 60,
+    F8  = 61,
+    F9  = 62,
+    F10 = 63,
+    F11 = 64,
+    F12 = 65,
+    F13 = 66,
+    F14 = 67,
+    F15 = 68,
+    F16 = 69,
+  };
+};
+
+namespace Modifier {
+  enum Note {
+    Shift   = 70,
+    Option  = 71,
+    Control = 72,
+    Alt     = 73,
+  };
+};
+
+namespace Automation {
+  enum Note {
+    On       = 74,
+    Record   = 75,
+    Snapshot = 77,
+    Touch    = 78,
+  };
+};
+
+namespace Utility {
+  enum Note {
+    Undo   = 76,
+    Cancel = 80,
+    Enter  = 81,
+    Redo   = 79,
+    Marker = 82,
+    Mixer  = 83,
+  };
+};
+
+namespace Marker {
+  enum Note {
+    PreviousFrame = 84,
+    NextFrame     = 85,
+    Loop          = 86,
+    PointIn       = 87,
+    PointOut      = 88,
+    Home          = 89,
+    End           = 90,
+  };
+};
+
+namespace Transport {
+  enum Note {
+    Rewind  = 91,
+    Forward = 92,
+    Stop    = 93,
+    Play    = 94,
+    Record  = 95,
+  };
+};
+
+namespace Navigation {
+  enum CC {
+    // Value CW=1/CCW=65.
+    Jog = 60
+  };
+
+  enum Note {
+    Up    = 96,
+    Down  = 97,
+    Left  = 98,
+    Right = 99,
+    Zoom  = 100,
+    Scrub = 101,
+  };
+};
+
+namespace UserSwitch {
+  enum Note {
+    S1 = 102,
+    S2 = 103,
+  };
+};
+
+namespace Protocol {
+  enum Note {
+    // TotalMix: Channel == 16, Velocity == 90, sent every ~800ms.
+    Ping = 127
+  };
+};
+};
@@ -0,0 +1,132 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2MackieSerializer.h"
+
+void V2MackieSerializer::reset() {
+  _count        = 0;
+  _skipped      = 0;
+  _running      = 0;
+  _waiting      = 0;
+
+  // The port is idle, the first read() refills the burst.
+  _budget.bytes = 0;
+  _budget.usec  = 0;
+
+  // The content of the display is unknown, every cell is sent at least once.
+  _display = {};
+}
+
+bool V2MackieSerializer::push(V2MIDI::Packet *packet) {
+  if (_count == sizeof(_window) / sizeof(_window[0]))
+    return false;
+
+  Message *message = &_window[_count];
+  message->length  = V2Mackie::getMessage(packet, message->data);
+  if (message->length == 0)
+    return false;
+
+  _count++;
+  return true;
+}
+
+// Messages to the same note, controller or channel cannot be reordered. The
+// position of a fader stays in order with its touch, the host records touch
+// automation from the sequence.
+static bool isSameTarget(const uint8_t *a, const uint8_t *b) {
+  if (V2Mackie::getMessageTarget(a) == V2Mackie::getMessageTarget(b))
+    return true;
+
+  const int8_t fader = V2Mackie::getMessageFader(a);
+  return fader >= 0 && fader == V2Mackie::getMessageFader(b);
+}
+
+// The index of the next message to send.
+uint8_t V2MackieSerializer::select() {
+  // Do not delay a message forever.
+  if (_running == 0 || _skipped >= 8)
+    return 0;
+
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_window[i].data[0] != _running)
+      continue;
+
+    bool blocked = false;
+    for (uint8_t j = 0; j < i; j++) {
+      if (isSameTarget(_window[j].data, _window[i].data)) {
+        blocked = true;
+        break;
+      }
+    }
+
+    if (!blocked)
+      return i;
+  }
+
+  return 0;
+}
+
+// Write one Display message with up to two consecutive changed cells.
+uint8_t V2MackieSerializer::readDisplay(uint8_t *buffer, uint8_t size, unsigned long now) {
+  uint8_t first;
+  uint8_t cells;
+  const uint8_t len = _display.select(first, cells);
+  if (len > size)
+    return 0;
+
+  if (!_budget.take(len, now))
+    return 0;
+
+  _display.read(buffer, first, cells);
+
+  // System Exclusive cancels the running status.
+  _running = 0;
+  _waiting = 0;
+  return len;
+}
+
+uint8_t V2MackieSerializer::read(uint8_t *buffer, uint8_t size, unsigned long now) {
+  uint8_t len  = 0;
+  bool display = false;
+  while (_count > 0) {
+    // Display text which was passed over too often.
+    if (!display && _display.dirty != 0 && _waiting >= 16) {
+      const uint8_t n = readDisplay(buffer + len, size - len, now);
+      if (n == 0)
+        break;
+
+      len += n;
+      display = true;
+      continue;
+    }
+
+    const uint8_t index    = select();
+    const Message *message = &_window[index];
+
+    // Skip the status byte if it is the same as the previous one.
+    const bool running = message->data[0] == _running;
+    const uint8_t n    = message->length - (running ? 1 : 0);
+    if (len + n > size)
+      break;
+
+    if (!_budget.take(n, now))
+      break;
+
+    memcpy(buffer + len, message->data + (running ? 1 : 0), n);
+    len += n;
+    _running = message->data[0];
+    _skipped = index == 0 ? 0 : _skipped + 1;
+
+    _count--;
+    memmove(&_window[index], &_window[index + 1], (_count - index) * sizeof(Message));
+
+    if (_display.dirty != 0 && _waiting < 255)
+      _waiting++;
+  }
+
+  // A single display chunk, after all pending channel messages.
+  if (!display && _count == 0 && _display.dirty != 0)
+    len += readDisplay(buffer + len, size - len, now);
+
+  return len;
+}
@@ -0,0 +1,83 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "V2Mackie.h"
+
+// Serialize the outgoing messages for a DIN/UART MIDI port. Messages are
+// reordered within a small window to group identical status bytes, which are
+// sent with MIDI running status. The output is limited to the bandwidth of
+// the port.
+//
+// The time 'now' is passed in by the caller, usually micros().
+//
+// Display text is sent in small Display messages of up to two strip cells,
+// pending channel messages are sent first. Display text which waited for 16
+// channel messages is sent ahead of the next one.
+class V2MackieSerializer {
+public:
+  // The longest Display message. A read() buffer needs at least this size to
+  // send display text; a shorter buffer carries only the channel messages.
+  static constexpr uint8_t DisplayMessageSize = V2Mackie::DisplayImage::MessageSize;
+
+  // DIN MIDI: 31250 baud, 10 bits per byte. A rate of 0 disables the limit.
+  void begin(uint16_t bytesPerSecond = 3125) {
+    _budget.rate = bytesPerSecond;
+    reset();
+  }
+
+  void reset();
+
+  // Returns false if the window is full.
+  bool push(V2MIDI::Packet *packet);
+
+  // Update the display text; only the changed cells are sent. The offset and
+  // the length are characters of the 2 x 56 character display.
+  void pushDisplay(uint8_t offset, const char *text, uint8_t len) {
+    _display.update(offset, text, len);
+  }
+
+  void pushText(uint8_t strip, uint8_t row, const char *text) {
+    _display.updateText(strip, row, text);
+  }
+
+  // Copy the next messages to the buffer, as many as the bandwidth budget
+  // allows at the time 'now'. Returns the number of bytes. The size should
+  // be at least DisplayMessageSize.
+  uint8_t read(uint8_t *buffer, uint8_t size, unsigned long now);
+
+  uint8_t getPending() {
+    return _count;
+  }
+
+  bool isDisplayPending() {
+    return _display.dirty != 0;
+  }
+
+private:
+  struct Message {
+    uint8_t data[3];
+    uint8_t length;
+  };
+
+  // The messages in the order of arrival.
+  Message _window[16]{};
+  uint8_t _count{};
+
+  // The number of times the oldest message was passed over.
+  uint8_t _skipped{};
+
+  // The last sent status byte, 0 if there is no running status.
+  uint8_t _running{};
+
+  // The number of channel messages sent while display text was pending.
+  uint8_t _waiting{};
+
+  V2Mackie::DisplayImage _display{};
+
+  V2Mackie::Budget _budget{};
+
+  uint8_t select();
+  uint8_t readDisplay(uint8_t *buffer, uint8_t size, unsigned long now);
+};
@@ -0,0 +1,24 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2Mackie.h"
+
+#if V2MACKIE_TRACE
+void V2Mackie::addTrace(Trace::Type type, uint8_t index, uint16_t value) {
+  _trace.records[_trace.next] = {.usec = (uint32_t)getMicros(), .type = type, .index = index, .value = value};
+  _trace.next                 = (_trace.next + 1) % V2MACKIE_TRACE_SIZE;
+  if (_trace.count < V2MACKIE_TRACE_SIZE)
+    _trace.count++;
+}
+
+uint16_t V2Mackie::readTrace(Trace::Record *records, uint16_t count) {
+  if (count > _trace.count)
+    count = _trace.count;
+
+  const uint16_t first = (_trace.next + V2MACKIE_TRACE_SIZE - _trace.count) % V2MACKIE_TRACE_SIZE;
+  for (uint16_t i = 0; i < count; i++)
+    records[i] = _trace.records[(first + i) % V2MACKIE_TRACE_SIZE];
+
+  return count;
+}
+#endif
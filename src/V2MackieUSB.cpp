@@ -0,0 +1,181 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#include "V2MackieUSB.h"
+#include "V2MackieProtocol.h"
+
+// USB-MIDI Code Index Numbers.
+namespace CodeIndex {
+enum {
+  SystemExclusiveStart     = 4,
+  SystemExclusiveEnd1Byte  = 5,
+  SystemExclusiveEnd2Bytes = 6,
+  SystemExclusiveEnd3Bytes = 7,
+};
+};
+
+void V2MackieUSB::reset() {
+  _head  = 0;
+  _count = 0;
+  _sysex = {};
+}
+
+void V2MackieUSB::add(uint8_t code, const uint8_t data[3]) {
+  uint8_t *event = _events[(_head + _count) % (sizeof(_events) / sizeof(_events[0]))];
+  event[0]       = _cable << 4 | code;
+  memcpy(event + 1, data, 3);
+  _count++;
+}
+
+// Stream the bytes of a System Exclusive message into 3-byte event packets.
+void V2MackieUSB::addSystemExclusive(uint8_t b) {
+  _sysex.data[_sysex.count++] = b;
+
+  if (b == 0xf7) {
+    memset(_sysex.data + _sysex.count, 0, 3 - _sysex.count);
+    add(CodeIndex::SystemExclusiveEnd1Byte + _sysex.count - 1, _sysex.data);
+    _sysex.count = 0;
+    return;
+  }
+
+  if (_sysex.count == 3) {
+    add(CodeIndex::SystemExclusiveStart, _sysex.data);
+    _sysex.count = 0;
+  }
+}
+
+bool V2MackieUSB::push(V2MIDI::Packet *packet, unsigned long now) {
+  if (getFree() == 0)
+    return false;
+
+  uint8_t message[3]{};
+  if (V2Mackie::getMessage(packet, message) == 0)
+    return false;
+
+  if (_count == 0)
+    _usec = now;
+
+  // Channel messages: the Code Index Number is the high nibble of the status byte.
+  add(message[0] >> 4, message);
+  return true;
+}
+
+bool V2MackieUSB::pushSystemExclusive(const uint8_t *buffer, uint32_t len, unsigned long now) {
+  if (len < 2 || (len + 2) / 3 > getFree())
+    return false;
+
+  if (_count == 0)
+    _usec = now;
+
+  for (uint32_t i = 0; i < len; i++)
+    addSystemExclusive(buffer[i]);
+
+  return true;
+}
+
+// The byte at the given position of a Display message.
+static uint8_t getDisplayByte(uint8_t position, uint8_t offset, const char *text, uint8_t len, uint8_t size) {
+  switch (position) {
+    case 0:
+      return 0xf0;
+
+    case 1 ... sizeof(Mackie::Message::Vendor):
+      return Mackie::Message::Vendor[position - 1];
+
+    case 1 + Mackie::Message::Header::Device:
+      return Mackie::Message::Device::Control;
+
+    case 1 + Mackie::Message::Header::Type:
+      return Mackie::Message::Type::Display;
+
+    case 1 + Mackie::Message::Header::Message + Mackie::Message::Display::Header::Index:
+      return offset;
+  }
+
+  const uint8_t character = position - (1 + Mackie::Message::Header::Message + Mackie::Message::Display::Header::Text);
+  if (character < len)
+    return text[character];
+
+  if (character < size)
+    return ' ';
+
+  return 0xf7;
+}
+
+void V2MackieUSB::setDisplayEvent(uint8_t event[4],
+                                  uint8_t cable,
+                                  uint8_t index,
+                                  uint8_t offset,
+                                  const char *text,
+                                  uint8_t len,
+                                  uint8_t size) {
+  const uint8_t end = 7 + size;
+
+  uint8_t n = 0;
+  for (; n < 3; n++) {
+    const uint8_t position = (index * 3) + n;
+    if (position > end)
+      break;
+
+    event[1 + n] = getDisplayByte(position, offset, text, len, size);
+  }
+
+  if ((index * 3) + 2 < end) {
+    event[0] = cable << 4 | CodeIndex::SystemExclusiveStart;
+    return;
+  }
+
+  // The last event packet carries 1 to 3 bytes.
+  memset(event + 1 + n, 0, 3 - n);
+  event[0] = cable << 4 | (CodeIndex::SystemExclusiveEnd1Byte + n - 1);
+}
+
+bool V2MackieUSB::addDisplay(uint8_t offset, const char *text, uint8_t len, uint8_t size, unsigned long now) {
+  if (offset + size > 56 * 2)
+    return false;
+
+  const uint8_t count = getDisplayEventCount(size);
+  if (count > getFree())
+    return false;
+
+  if (_count == 0)
+    _usec = now;
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t *event = _events[(_head + _count) % (sizeof(_events) / sizeof(_events[0]))];
+    setDisplayEvent(event, _cable, i, offset, text, len, size);
+    _count++;
+  }
+
+  return true;
+}
+
+bool V2MackieUSB::pushDisplay(uint8_t offset, const char *text, uint8_t len, unsigned long now) {
+  return addDisplay(offset, text, len, len, now);
+}
+
+bool V2MackieUSB::pushText(uint8_t strip, uint8_t row, const char *text, unsigned long now) {
+  uint8_t len = strlen(text);
+  if (len > 7)
+    len = 7;
+
+  return addDisplay((56 * row) + (7 * strip), text, len, 7, now);
+}
+
+uint8_t V2MackieUSB::read(uint8_t frame[64], unsigned long now) {
+  if (_count == 0)
+    return 0;
+
+  if (_count < 16 && (unsigned long)(now - _usec) < _deadline)
+    return 0;
+
+  const uint8_t n = _count < 16 ? _count : 16;
+  for (uint8_t i = 0; i < n; i++) {
+    memcpy(frame + (i * 4), _events[_head], 4);
+    _head = (_head + 1) % (sizeof(_events) / sizeof(_events[0]));
+  }
+
+  // The remaining events are older than the next ones, keep the time.
+  _count -= n;
+  return n * 4;
+}
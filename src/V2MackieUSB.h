@@ -0,0 +1,79 @@
+// © Kay Sievers <kay@versioduo.com>, 2020-2022
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "V2Mackie.h"
+
+// Pack the outgoing messages into USB-MIDI bulk endpoint frames; up to 16 event
+// packets of 4 bytes in a 64 bytes frame. A frame is ready when it is full, or
+// when the oldest pending event has waited for the deadline. The time 'now'
+// is passed in by the caller, usually micros().
+class V2MackieUSB {
+public:
+  void begin(uint8_t cable = 0, uint16_t deadlineUsec = 1000) {
+    _cable    = cable;
+    _deadline = deadlineUsec;
+    reset();
+  }
+
+  void reset();
+
+  // Returns false if there is no room for the message.
+  bool push(V2MIDI::Packet *packet, unsigned long now);
+  bool pushSystemExclusive(const uint8_t *buffer, uint32_t len, unsigned long now);
+
+  // Display messages, the event packets are created directly from the text.
+  // The offset and the length are characters of the 2 x 56 character display.
+  bool pushDisplay(uint8_t offset, const char *text, uint8_t len, unsigned long now);
+  bool pushText(uint8_t strip, uint8_t row, const char *text, unsigned long now);
+
+  // Create the event packets of a Display message one at a time, without a
+  // message buffer. The text is padded with spaces up to 'size' characters.
+  static uint8_t getDisplayEventCount(uint8_t size) {
+    // Header, offset, characters, end.
+    return (7 + size + 1 + 2) / 3;
+  }
+
+  static void setDisplayEvent(uint8_t event[4],
+                              uint8_t cable,
+                              uint8_t index,
+                              uint8_t offset,
+                              const char *text,
+                              uint8_t len,
+                              uint8_t size);
+
+  // Copy the next frame, returns the number of bytes, 0 if no frame is ready.
+  uint8_t read(uint8_t frame[64], unsigned long now);
+
+  // The number of pending event packets.
+  uint8_t getPending() {
+    return _count;
+  }
+
+private:
+  uint8_t _cable{};
+  uint16_t _deadline{};
+
+  // Ring buffer of USB-MIDI event packets.
+  uint8_t _events[64][4]{};
+  uint8_t _head{};
+  uint8_t _count{};
+
+  // The time the oldest pending event was added.
+  unsigned long _usec{};
+
+  // The bytes of an incomplete System Exclusive event.
+  struct {
+    uint8_t data[3];
+    uint8_t count;
+  } _sysex{};
+
+  uint8_t getFree() {
+    return sizeof(_events) / sizeof(_events[0]) - _count;
+  }
+
+  void add(uint8_t code, const uint8_t data[3]);
+  void addSystemExclusive(uint8_t b);
+  bool addDisplay(uint8_t offset, const char *text, uint8_t len, uint8_t size, unsigned long now);
+};